@@ -0,0 +1,185 @@
+#include "common.h"
+#include <algorithm>
+#include <random>
+#include <math.h>
+#include <ppl.h>
+
+// The concurrency runtime can't be used from managed code, so the unit
+//  tests build this file without /clr.
+
+namespace Boggle {
+    OptimizerSettings::OptimizerSettings (unsigned _width, unsigned _height)
+        : width(_width)
+        , height(_height)
+        , chainCount(8)
+        , iterations(20000)
+        , initialTemperature(32.0)
+        , seed(1)
+    {
+    }
+
+    // Draws a number in [0, bound) straight from the generator. The output
+    //  of mt19937 is fully specified, but what the standard distributions
+    //  make of it is not, so using them would give different boards for the
+    //  same seed on different standard libraries. Draws from the incomplete
+    //  range at the top are rejected so that every result is equally likely.
+    static unsigned drawBelow (std::mt19937 & random, unsigned bound) {
+        const unsigned __int64 range = 0x100000000ULL;
+        const unsigned __int64 limit = range - (range % bound);
+
+        for (;;) {
+            unsigned __int64 value = random() & 0xFFFFFFFF;
+            if (value < limit)
+                return (unsigned)(value % bound);
+        }
+    }
+
+    // Draws a number in [0, 1) by scaling the generator's raw output, for the
+    //  same reason.
+    static inline double drawFraction (std::mt19937 & random) {
+        return (double)(random() & 0xFFFFFFFF) / 4294967296.0;
+    }
+
+    // Picks letters in proportion to how often they appear in the words of
+    //  a dictionary, so that boards start out, and stay, roughly as full of
+    //  vowels and common consonants as the words they are meant to contain.
+    class LetterDistribution {
+    private:
+        // cumulativeCounts[i] is the number of times letters up to and
+        //  including 'a' + i appear.
+        unsigned cumulativeCounts[26];
+
+    public:
+        LetterDistribution (const Dictionary * dictionary) {
+            unsigned letterCounts[26] = { 0 };
+            for (WordId id = 0; id < dictionary->wordCount; id++) {
+                for (const char * ch = dictionary->word(id); *ch; ch++)
+                    letterCounts[*ch - 'a'] += 1;
+            }
+
+            unsigned total = 0;
+            for (unsigned i = 0; i < 26; i++) {
+                total += letterCounts[i];
+                cumulativeCounts[i] = total;
+            }
+
+            if (total == 0)
+                throw std::exception("Dictionary has no words");
+        }
+
+        inline char pick (std::mt19937 & random) const {
+            unsigned count = drawBelow(random, cumulativeCounts[25]);
+            return 'a' + (char)(std::upper_bound(cumulativeCounts, cumulativeCounts + 26, count) - cumulativeCounts);
+        }
+    };
+
+    static std::string boardCharacters (const Board & board) {
+        std::string result;
+        result.reserve((board.width + 1) * board.height);
+
+        for (unsigned row = 0; row < board.height; row++) {
+            for (unsigned col = 0; col < board.width; col++)
+                result += board.at(col, row);
+
+            result += '\n';
+        }
+
+        return result;
+    }
+
+    // Runs one annealing chain from a random board and returns the best
+    //  board it came across. Everything the chain does follows from its
+    //  seed.
+    static ScoredBoard runChain (
+        const Dictionary * dictionary, const LetterDistribution & letters,
+        const OptimizerSettings & settings, unsigned seed
+    ) {
+        std::mt19937 random(seed);
+        unsigned cellCount = settings.width * settings.height;
+
+        Board board(settings.width, settings.height);
+        for (unsigned cell = 0; cell < cellCount; cell++)
+            board.at(cell % settings.width, cell / settings.width) = letters.pick(random);
+
+        // Only the score of each board is needed, so the chain can use the
+        //  score-only solve and reuse one set of found words throughout.
+        FoundWords found;
+        BoardScore current = board.scoreWords(dictionary, found);
+
+        ScoredBoard best;
+        best.characters = boardCharacters(board);
+        best.score = current;
+        best.seed = seed;
+
+        for (unsigned i = 0; i < settings.iterations; i++) {
+            double temperature = settings.initialTemperature * (settings.iterations - i) / settings.iterations;
+
+            // Either swap the letters in two different cells, or put a new
+            //  letter in one. The second cell of a swap is drawn from the
+            //  other cellCount - 1 cells; a board with a single cell can only
+            //  have its letter replaced.
+            unsigned first = drawBelow(random, cellCount), second = first;
+            if (cellCount > 1) {
+                second = drawBelow(random, cellCount - 1);
+                if (second >= first)
+                    second++;
+            }
+
+            char & firstLetter = board.at(first % settings.width, first / settings.width);
+            char & secondLetter = board.at(second % settings.width, second / settings.width);
+            char oldFirst = firstLetter, oldSecond = secondLetter;
+
+            if ((first != second) && drawBelow(random, 2))
+                std::swap(firstLetter, secondLetter);
+            else
+                firstLetter = letters.pick(random);
+
+            BoardScore candidate = board.scoreWords(dictionary, found);
+            double change = (double)candidate.score - (double)current.score;
+
+            // Always keep changes that don't lose points, and sometimes keep
+            //  ones that do, less often the worse they are and the further
+            //  the chain has cooled.
+            bool keep = (change >= 0);
+            if (!keep && (temperature > 0))
+                keep = drawFraction(random) < exp(change / temperature);
+
+            if (!keep) {
+                secondLetter = oldSecond;
+                firstLetter = oldFirst;
+                continue;
+            }
+
+            current = candidate;
+            if (current.score > best.score.score) {
+                best.characters = boardCharacters(board);
+                best.score = current;
+            }
+        }
+
+        return best;
+    }
+
+    static bool isBetterBoard (const ScoredBoard & lhs, const ScoredBoard & rhs) {
+        if (lhs.score.score != rhs.score.score)
+            return lhs.score.score > rhs.score.score;
+
+        return lhs.seed < rhs.seed;
+    }
+
+    std::vector<ScoredBoard> optimizeBoards (const Dictionary * dictionary, const OptimizerSettings & settings) {
+        if ((settings.width == 0) || (settings.height == 0))
+            throw std::exception("Board must have at least one cell");
+
+        LetterDistribution letters(dictionary);
+        std::vector<ScoredBoard> results(settings.chainCount);
+
+        // The chains only share the dictionary, which they never modify.
+        Concurrency::parallel_for(0u, settings.chainCount, [&](unsigned chain) {
+            results[chain] = runChain(dictionary, letters, settings, settings.seed + chain);
+        });
+
+        std::sort(results.begin(), results.end(), isBetterBoard);
+        return results;
+    }
+}
\ No newline at end of file
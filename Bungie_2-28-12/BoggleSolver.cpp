@@ -2,9 +2,10 @@
 #include <direct.h>
 #include <stdio.h>
 #include <sys/stat.h>
-#include <stack>
-#include <sstream>
 #include <algorithm>
+#include <xmmintrin.h>
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
 
 // Reads the entire contents of a file into a buffer (that you must delete using delete[]). The buffer is null terminated.
 // At completion fileSize will be updated to contain the size of the file's contents (not including the null terminator).
@@ -48,9 +49,10 @@ namespace Boggle {
     // Boggle rules state that a valid word must be 3 letters.
     const unsigned MINIMUM_WORD_LENGTH = 3;
 
-    Node::Node (char _character, bool _isValidWord)
-        : isValidWord(_isValidWord)
+    Node::Node (char _character)
+        : wordId(NO_WORD)
         , character(_character)
+        , childLetters(0)
     {
         // Within a node, 0 represents no child instead of representing the root,
         //  because no node can ever point back to the root node.
@@ -60,20 +62,40 @@ namespace Boggle {
     // Creates a new node for the given character and returns its NodeIndex.
     // Note that calling this may resize the nodes vector and invalidate any references
     //  to existing nodes.
-    NodeIndex Dictionary::allocateNode (char character, bool isValidWord) {
+    NodeIndex Dictionary::allocateNode (char character) {
         NodeIndex result = nodes.size();
-        nodes.push_back(Node(character, isValidWord));
+        nodes.push_back(Node(character));
         return result;
     }
 
     Dictionary::Dictionary (const char * dictionaryPath)
         : wordCount(0)
+        , listCount(1)
     {
         // Allocate node 0 to be the root.
         nodes.reserve(DEFAULT_DICTIONARY_SIZE);
         // The root node does not actually contain character information, just children.
-        nodes.push_back(Node('\0', false));
+        nodes.push_back(Node('\0'));
 
+        addWordsFromFile(dictionaryPath, 0);
+    }
+
+    Dictionary::Dictionary (const char * const dictionaryPaths[], unsigned _listCount)
+        : wordCount(0)
+        , listCount(_listCount)
+    {
+        if ((listCount == 0) || (listCount > MAXIMUM_WORD_LISTS))
+            throw std::exception("Invalid number of word lists");
+
+        nodes.reserve(DEFAULT_DICTIONARY_SIZE);
+        nodes.push_back(Node('\0'));
+
+        for (unsigned list = 0; list < listCount; list++)
+            addWordsFromFile(dictionaryPaths[list], list);
+    }
+
+    // Adds every word in a file, one per line, to the given list.
+    void Dictionary::addWordsFromFile (const char * dictionaryPath, unsigned list) {
         const char * dictionaryBuffer;
         size_t dictionaryLength;
 
@@ -88,7 +110,7 @@ namespace Boggle {
               if ((ch == '\n') || (ch == '\r') || (ch == '\0')) {
                   size_t currentWordLength = i - currentWordStart;
                   if (currentWordLength)
-                      addWord(dictionaryBuffer + currentWordStart, currentWordLength);
+                      addWord(dictionaryBuffer + currentWordStart, currentWordLength, list);
 
                   currentWordStart = i + 1;
               }
@@ -96,7 +118,7 @@ namespace Boggle {
 
           size_t currentWordLength = dictionaryLength - currentWordStart;
           if ((currentWordLength + currentWordStart <= dictionaryLength) && (currentWordLength))
-              addWord(dictionaryBuffer + currentWordStart, currentWordLength);
+              addWord(dictionaryBuffer + currentWordStart, currentWordLength, list);
           
           delete[] dictionaryBuffer;
         } catch (...) {
@@ -105,7 +127,12 @@ namespace Boggle {
         }
     }
 
-    NodeIndex Dictionary::addWord (const char * word, size_t wordLength) {
+    NodeIndex Dictionary::addWord (const char * word, size_t wordLength, unsigned list) {
+        if (list >= MAXIMUM_WORD_LISTS)
+            throw std::exception("Word list index out of range");
+        else if (list >= listCount)
+            listCount = list + 1;
+
         // Start at the root
         NodeIndex currentIndex = 0;        
 
@@ -123,22 +150,165 @@ namespace Boggle {
                 throw std::exception("Malformed trie");
 
             NodeIndex nextIndex = nodes[currentIndex].children[index];
-            if (nextIndex == 0)
+            if (nextIndex == 0) {
                 // We need to evaluate nodes[currentIndex] again here because allocateNode may resize nodes
-                nextIndex = nodes[currentIndex].children[index] = allocateNode(ch, i == wordLength - 1);
+                nextIndex = nodes[currentIndex].children[index] = allocateNode(ch);
+                nodes[currentIndex].childLetters |= 1 << index;
+            }
 
             currentIndex = nextIndex;
         }
 
+        // Words that are already in the dictionary keep their existing id,
+        //  and just join the list.
+        if (nodes[currentIndex].wordId != NO_WORD) {
+            wordListMasks[nodes[currentIndex].wordId] |= 1U << list;
+            return currentIndex;
+        }
+
+        nodes[currentIndex].wordId = wordOffsets.size();
+        wordOffsets.push_back(wordPool.size());
+        wordListMasks.push_back(1U << list);
+        for (unsigned i = 0; i < wordLength; i++)
+            wordPool.push_back(tolower(word[i]));
+        wordPool.push_back('\0');
+
         wordCount++;
         return currentIndex;
     }
 
+    NodeIndex GaddagDictionary::allocateNode (char character) {
+        NodeIndex result = nodes.size();
+        nodes.push_back(Node(character));
+        separators.push_back(0);
+        return result;
+    }
+
+    // Returns the child of a node for the given character, creating it if
+    //  it doesn't exist yet.
+    NodeIndex GaddagDictionary::addChild (NodeIndex parentIndex, char ch) {
+        int index = ch - 'a';
+        NodeIndex childIndex = nodes[parentIndex].children[index];
+        if (childIndex == 0) {
+            childIndex = allocateNode(ch);
+            // allocateNode may have resized nodes, so look the parent up again.
+            nodes[parentIndex].children[index] = childIndex;
+            nodes[parentIndex].childLetters |= 1 << index;
+        }
+
+        return childIndex;
+    }
+
+    GaddagDictionary::GaddagDictionary (const Dictionary * _dictionary)
+        : dictionary(_dictionary)
+    {
+        // Count how often each letter appears so the letters can be ranked
+        //  from rarest to most common. Ties keep alphabetical order.
+        unsigned letterCounts[26] = { 0 };
+        for (WordId id = 0; id < dictionary->wordCount; id++) {
+            for (const char * ch = dictionary->word(id); *ch; ch++)
+                letterCounts[*ch - 'a'] += 1;
+        }
+
+        unsigned char lettersByRarity[26];
+        for (unsigned i = 0; i < 26; i++) {
+            unsigned j = i;
+            for (; (j > 0) && (letterCounts[lettersByRarity[j - 1]] > letterCounts[i]); j--)
+                lettersByRarity[j] = lettersByRarity[j - 1];
+
+            lettersByRarity[j] = i;
+        }
+
+        for (unsigned i = 0; i < 26; i++)
+            letterRanks[lettersByRarity[i]] = i;
+
+        nodes.reserve(DEFAULT_DICTIONARY_SIZE);
+        separators.reserve(DEFAULT_DICTIONARY_SIZE);
+        allocateNode('\0');
+
+        for (WordId id = 0; id < dictionary->wordCount; id++) {
+            const char * word = dictionary->word(id);
+            unsigned wordLength = dictionary->wordLength(id);
+
+            // Words that are too short to score could never be found anyway.
+            if (wordLength < MINIMUM_WORD_LENGTH)
+                continue;
+
+            unsigned anchor = 0;
+            for (unsigned i = 1; i < wordLength; i++) {
+                if (letterRanks[word[i] - 'a'] < letterRanks[word[anchor] - 'a'])
+                    anchor = i;
+            }
+
+            NodeIndex currentIndex = 0;
+            for (unsigned i = anchor + 1; i > 0; i--)
+                currentIndex = addChild(currentIndex, word[i - 1]);
+
+            if (separators[currentIndex] == 0) {
+                NodeIndex separatorIndex = allocateNode('\0');
+                separators[currentIndex] = separatorIndex;
+            }
+
+            currentIndex = separators[currentIndex];
+            for (unsigned i = anchor + 1; i < wordLength; i++)
+                currentIndex = addChild(currentIndex, word[i]);
+
+            nodes[currentIndex].wordId = id;
+        }
+    }
+
+    FoundWords::FoundWords ()
+        : generation(0)
+    {
+    }
+
+    void FoundWords::clear (unsigned wordCount) {
+        ids.clear();
+
+        if (stamps.size() < wordCount)
+            stamps.resize(wordCount, generation);
+
+        // Once the generation counter wraps around, old stamps could match new
+        //  generations, so we have to start over with a clean slate.
+        if (++generation == 0) {
+            std::fill(stamps.begin(), stamps.end(), 0);
+            generation = 1;
+        }
+    }
+
     Board::Board (unsigned _width, unsigned _height)
         : width(_width)
         , height(_height)
         , characters(new char[_width * _height])
+        , neighborCells(_width * _height * MAXIMUM_NEIGHBORS)
+        , neighborCounts(_width * _height)
     {
+        // Work out which cells neighbor each other once, up front, so that the
+        //  solver never has to check whether it is about to walk off the board.
+        for (unsigned row = 0; row < _height; row++) {
+            for (unsigned col = 0; col < _width; col++) {
+                unsigned cell = (row * _width) + col;
+                unsigned count = 0;
+
+                for (int dy = -1; dy <= 1; dy++) {
+                    for (int dx = -1; dx <= 1; dx++) {
+                        int neighborCol = col + dx, neighborRow = row + dy;
+
+                        if ((dx == 0) && (dy == 0))
+                            continue;
+                        if ((neighborCol < 0) || (neighborCol >= (int)_width))
+                            continue;
+                        if ((neighborRow < 0) || (neighborRow >= (int)_height))
+                            continue;
+
+                        neighborCells[(cell * MAXIMUM_NEIGHBORS) + count] = (neighborRow * _width) + neighborCol;
+                        count += 1;
+                    }
+                }
+
+                neighborCounts[cell] = count;
+            }
+        }
     }
 
     Board::~Board () {
@@ -227,96 +397,1066 @@ namespace Boggle {
         return characters[(row * width) + col];
     }
 
-    static void exploreCellNeighbors (
-        const Board * board, const Dictionary * dictionary, std::set<std::string> & result, 
-        std::vector<CellId> cellStack, std::vector<NodeIndex> nodeStack
-    ) {
+    // Everything a search needs to keep track of as it walks the board. It is
+    //  shared by every step of the recursion instead of being copied.
+    struct SearchState {
+        const Board * board;
+        const Dictionary * dictionary;
+        FoundWords & found;
+        WordSink * sink;
+        // The word lists whose words count.
+        unsigned lists;
+        // The cells that spell out the current prefix, and a flag for each
+        //  cell on the board that is set while the cell is part of it.
+        std::vector<CellId> path;
+        std::vector<char> visited;
+
+        SearchState (const Board * _board, const Dictionary * _dictionary, FoundWords & _found, WordSink * _sink, unsigned _lists = ALL_WORD_LISTS)
+            : board(_board)
+            , dictionary(_dictionary)
+            , found(_found)
+            , sink(_sink)
+            , lists(_lists)
+            , visited(_board->width * _board->height, 0)
+        {
+            path.reserve(_board->width * _board->height);
+        }
+    };
+
+    SolveStats::SolveStats ()
+        : nodesVisited(0)
+        , deadEnds(0)
+        , revisitsRejected(0)
+    {
+    }
+
+    void SolveStats::clear (unsigned cellCount) {
+        nodesVisited = deadEnds = revisitsRejected = 0;
+        depthCounts.assign(cellCount, 0);
+        startCellSeconds.assign(cellCount, 0);
+    }
+
+    // The counters exploreCell updates as it goes. nodeVisited is called
+    //  before each trie node is entered, and can return false to stop the
+    //  search there. This version does nothing, so ordinary solves compile
+    //  down to the same code as if it weren't there.
+    struct NoStats {
+        inline bool nodeVisited (size_t) {
+            return true;
+        }
+
+        inline void deadEnd () {
+        }
+
+        inline void revisitRejected () {
+        }
+    };
+
+    struct CountingStats {
+        SolveStats & stats;
+
+        CountingStats (SolveStats & _stats)
+            : stats(_stats) {
+        }
+
+        inline bool nodeVisited (size_t depth) {
+            stats.nodesVisited += 1;
+            stats.depthCounts[depth - 1] += 1;
+            return true;
+        }
+
+        inline void deadEnd () {
+            stats.deadEnds += 1;
+        }
+
+        inline void revisitRejected () {
+            stats.revisitsRejected += 1;
+        }
+    };
+
+    SolveBudget::SolveBudget (unsigned __int64 _maximumNodes, double _maximumSeconds)
+        : maximumNodes(_maximumNodes)
+        , maximumSeconds(_maximumSeconds)
+    {
+    }
+
+    // Reading the clock costs about as much as visiting a node, so a search
+    //  with a deadline only checks it this often.
+    const unsigned NODES_PER_CLOCK_CHECK = 1024;
+
+    // Stops a search once it has visited as many nodes as its budget allows
+    //  or has run past its deadline.
+    struct BudgetStats {
+        const SolveBudget & budget;
+        unsigned __int64 nodesVisited;
+        LONGLONG deadline;
+        unsigned nodesUntilClockCheck;
+
+        BudgetStats (const SolveBudget & _budget)
+            : budget(_budget)
+            , nodesVisited(0)
+            , deadline(0)
+            , nodesUntilClockCheck(NODES_PER_CLOCK_CHECK)
+        {
+            if (budget.maximumSeconds > 0) {
+                LARGE_INTEGER frequency, now;
+                QueryPerformanceFrequency(&frequency);
+                QueryPerformanceCounter(&now);
+
+                deadline = now.QuadPart + (LONGLONG)(budget.maximumSeconds * frequency.QuadPart);
+            }
+        }
+
+        inline bool nodeVisited (size_t) {
+            if (budget.maximumNodes && (nodesVisited >= budget.maximumNodes))
+                return false;
+
+            nodesVisited += 1;
+
+            if (deadline && (--nodesUntilClockCheck == 0)) {
+                nodesUntilClockCheck = NODES_PER_CLOCK_CHECK;
+
+                LARGE_INTEGER now;
+                QueryPerformanceCounter(&now);
+                if (now.QuadPart >= deadline)
+                    return false;
+            }
+
+            return true;
+        }
+
+        inline void deadEnd () {
+        }
+
+        inline void revisitRejected () {
+        }
+    };
+
+    // Returns true if a word belongs to one of the selected word lists. Most
+    //  solves count every list, which doesn't need a lookup.
+    static inline bool isInLists (const Dictionary * dictionary, WordId id, unsigned lists) {
+        return (lists == ALL_WORD_LISTS) || ((dictionary->wordLists(id) & lists) != 0);
+    }
+
+    // Extends the current path with the given cell and explores all of the
+    //  words that can be formed from there. Returns false if the sink or the
+    //  stats asked for the search to stop.
+    template <typename TStats>
+    static bool exploreCell (SearchState & state, TStats & stats, unsigned cell, NodeIndex parentIndex) {
         // First, grab the character value for the current cell, and fetch its
         //  associated node from the dictionary trie, if it exists.
-        char ch = board->at(cellStack.back().x, cellStack.back().y);
-        const Node & parentNode = dictionary->node(nodeStack.back());
+        char ch = state.board->cellAt(cell);
+        const Node & parentNode = state.dictionary->node(parentIndex);
         // The current node in the dictionary trie may not have any children for
         //  the current cell. If so, we can stop here without exploring neighbors.
-        if (!parentNode.contains(ch))
-            return;
+        if (!parentNode.contains(ch)) {
+            stats.deadEnd();
+            return true;
+        }
 
         NodeIndex nodeIndex = parentNode.children[ch - 'a'];
-        nodeStack.push_back(nodeIndex);
-        
+        const Node & node = state.dictionary->node(nodeIndex);
+
+        if (!stats.nodeVisited(state.path.size() + 1))
+            return false;
+
+        state.path.push_back(CellId(cell % state.board->width, cell / state.board->width));
+        state.visited[cell] = 1;
+
         // If the dictionary trie had a child for the current cell, and it is a
-        //  valid word, add it to the results list.
-        if ((nodeStack.size() > MINIMUM_WORD_LENGTH) && dictionary->node(nodeIndex).isValidWord) {
-            // Convert the nodes on the stack into a string by walking them and
-            //  concatenating their characters together.
-            std::stringstream w;
-            std::vector<NodeIndex>::iterator iter = nodeStack.begin();
-
-            while (iter != nodeStack.end()) {
-                // Ignore the root node
-                if (*iter != 0) {
-                    char ch = dictionary->node(*iter).character;
-                    w << ch;
+        //  valid word, add it to the results list. The result set ignores words
+        //  that have already been found, so the sink only hears about new ones.
+        bool keepGoing = true;
+        if ((state.path.size() >= MINIMUM_WORD_LENGTH) && node.isValidWord() && isInLists(state.dictionary, node.wordId, state.lists)) {
+            if (state.found.insert(node.wordId) && state.sink)
+                keepGoing = state.sink->wordFound(node.wordId, &state.path[0], state.path.size());
+        }
+
+        // Cells already on the path can't be reused.
+        const unsigned * neighbors = state.board->neighbors(cell);
+        for (unsigned i = 0, count = state.board->neighborCount(cell); keepGoing && (i < count); i++) {
+            if (!state.visited[neighbors[i]])
+                keepGoing = exploreCell(state, stats, neighbors[i], nodeIndex);
+            else
+                stats.revisitRejected();
+        }
+
+        state.visited[cell] = 0;
+        state.path.pop_back();
+        return keepGoing;
+    }
+
+    // Moves a fixed size search from Cell to the neighbor at (Dx, Dy), if there is one. Whether the
+    //  neighbor exists is worked out at compile time, so edge cells simply have fewer steps.
+    template <
+        typename TSearch, unsigned Cell, int Dx, int Dy,
+        bool InBounds = 
+            ((int)(Cell % TSearch::WIDTH) + Dx >= 0) && ((int)(Cell % TSearch::WIDTH) + Dx < (int)TSearch::WIDTH) &&
+            ((int)(Cell / TSearch::WIDTH) + Dy >= 0) && ((int)(Cell / TSearch::WIDTH) + Dy < (int)TSearch::HEIGHT)
+    >
+    struct NeighborStep {
+        static inline bool explore (TSearch & search, NodeIndex nodeIndex, typename TSearch::CellMask visited) {
+            const unsigned neighbor = (unsigned)((int)Cell + (Dy * (int)TSearch::WIDTH) + Dx);
+
+            // Cells already on the path can't be reused.
+            if (visited & ((typename TSearch::CellMask)1 << neighbor))
+                return true;
+
+            return search.template exploreCell<neighbor>(nodeIndex, visited);
+        }
+    };
+
+    template <typename TSearch, unsigned Cell, int Dx, int Dy>
+    struct NeighborStep<TSearch, Cell, Dx, Dy, false> {
+        static inline bool explore (TSearch &, NodeIndex, typename TSearch::CellMask) {
+            return true;
+        }
+    };
+
+    // Starts a fixed size search from Cell and then from every cell after it.
+    template <typename TSearch, unsigned Cell, bool Done = (Cell == TSearch::CELL_COUNT)>
+    struct EveryCell {
+        static inline bool explore (TSearch & search) {
+            return search.template exploreCell<Cell>(0, 0) && EveryCell<TSearch, Cell + 1>::explore(search);
+        }
+    };
+
+    template <typename TSearch, unsigned Cell>
+    struct EveryCell<TSearch, Cell, true> {
+        static inline bool explore (TSearch &) {
+            return true;
+        }
+    };
+
+    // The same search as exploreCell, specialized for one board size. Every
+    //  cell's position and neighbors are template arguments, so the neighbor
+    //  loop unrolls into straight-line code, and the visited cells fit in a
+    //  single 64-bit mask that is passed down the recursion by value.
+    template <unsigned Width, unsigned Height>
+    class FixedSizeSearch {
+    public:
+        enum {
+            WIDTH = Width,
+            HEIGHT = Height,
+            CELL_COUNT = Width * Height
+        };
+
+        static_assert(CELL_COUNT <= 64, "Board is too big for a 64-bit visited mask");
+
+        typedef unsigned __int64 CellMask;
+
+    private:
+        const Board * board;
+        const Dictionary * dictionary;
+        FoundWords & found;
+        WordSink * sink;
+        unsigned lists;
+        std::vector<CellId> path;
+
+    public:
+        FixedSizeSearch (const Board * _board, const Dictionary * _dictionary, FoundWords & _found, WordSink * _sink, unsigned _lists)
+            : board(_board)
+            , dictionary(_dictionary)
+            , found(_found)
+            , sink(_sink)
+            , lists(_lists)
+        {
+            path.reserve(CELL_COUNT);
+        }
+
+        template <unsigned Cell>
+        bool exploreCell (NodeIndex parentIndex, CellMask visited) {
+            char ch = board->cellAt(Cell);
+            const Node & parentNode = dictionary->node(parentIndex);
+            if (!parentNode.contains(ch))
+                return true;
+
+            NodeIndex nodeIndex = parentNode.children[ch - 'a'];
+            const Node & node = dictionary->node(nodeIndex);
+
+            path.push_back(CellId(Cell % Width, Cell / Width));
+            visited |= (CellMask)1 << Cell;
+
+            bool keepGoing = true;
+            if ((path.size() >= MINIMUM_WORD_LENGTH) && node.isValidWord() && isInLists(dictionary, node.wordId, lists)) {
+                if (found.insert(node.wordId) && sink)
+                    keepGoing = sink->wordFound(node.wordId, &path[0], path.size());
+            }
+
+            keepGoing = keepGoing &&
+                NeighborStep<FixedSizeSearch, Cell, -1, -1>::explore(*this, nodeIndex, visited) &&
+                NeighborStep<FixedSizeSearch, Cell,  0, -1>::explore(*this, nodeIndex, visited) &&
+                NeighborStep<FixedSizeSearch, Cell,  1, -1>::explore(*this, nodeIndex, visited) &&
+                NeighborStep<FixedSizeSearch, Cell, -1,  0>::explore(*this, nodeIndex, visited) &&
+                NeighborStep<FixedSizeSearch, Cell,  1,  0>::explore(*this, nodeIndex, visited) &&
+                NeighborStep<FixedSizeSearch, Cell, -1,  1>::explore(*this, nodeIndex, visited) &&
+                NeighborStep<FixedSizeSearch, Cell,  0,  1>::explore(*this, nodeIndex, visited) &&
+                NeighborStep<FixedSizeSearch, Cell,  1,  1>::explore(*this, nodeIndex, visited);
+
+            path.pop_back();
+            return keepGoing;
+        }
+
+        bool run () {
+            return EveryCell<FixedSizeSearch, 0>::explore(*this);
+        }
+    };
+
+    // Starts a search from every cell on the board in turn, counting words
+    //  from the selected lists. Returns false if the sink asked for the
+    //  search to stop.
+    static bool findWordsInBoard (const Board * board, const Dictionary * dictionary, FoundWords & found, WordSink * sink, unsigned lists = ALL_WORD_LISTS) {
+        found.clear(dictionary->wordCount);
+
+        // Standard game sizes get a search specialized for their dimensions.
+        if ((board->width == 4) && (board->height == 4))
+            return FixedSizeSearch<4, 4>(board, dictionary, found, sink, lists).run();
+        else if ((board->width == 5) && (board->height == 5))
+            return FixedSizeSearch<5, 5>(board, dictionary, found, sink, lists).run();
+        else if ((board->width == 6) && (board->height == 6))
+            return FixedSizeSearch<6, 6>(board, dictionary, found, sink, lists).run();
+
+        SearchState state(board, dictionary, found, sink, lists);
+        NoStats stats;
+
+        for (unsigned cell = 0, cellCount = board->width * board->height; cell < cellCount; cell++) {
+            if (!exploreCell(state, stats, cell, 0))
+                return false;
+        }
+
+        return true;
+    }
+
+    // Scans the entire board for words using a provided dictionary, storing
+    //  the ids of the unique words found in result.
+    void Board::findWords (const Dictionary * dictionary, FoundWords & result) const {
+        findWordsInBoard(this, dictionary, result, 0);
+    }
+
+    // Scans the entire board for words that belong to at least one of the
+    //  selected word lists.
+    void Board::findWords (const Dictionary * dictionary, unsigned lists, FoundWords & result) const {
+        findWordsInBoard(this, dictionary, result, 0, lists);
+    }
+
+    // Scans the entire board for words using a provided dictionary, handing
+    //  each unique word to sink as it is found. Stops as soon as the sink
+    //  returns false.
+    bool Board::findWords (const Dictionary * dictionary, WordSink & sink, FoundWords & found) const {
+        return findWordsInBoard(this, dictionary, found, &sink);
+    }
+
+    bool Board::findWords (const Dictionary * dictionary, WordSink & sink) const {
+        FoundWords found;
+        return findWords(dictionary, sink, found);
+    }
+
+    // Scans the entire board for words with the generic search, counting
+    //  its work as it goes. The fixed size searches walk exactly the same
+    //  paths, so the counts hold for them too.
+    void Board::findWords (const Dictionary * dictionary, FoundWords & result, SolveStats & stats) const {
+        unsigned cellCount = width * height;
+
+        result.clear(dictionary->wordCount);
+        stats.clear(cellCount);
+
+        SearchState state(this, dictionary, result, 0);
+        CountingStats counter(stats);
+
+        LARGE_INTEGER frequency, start, end;
+        QueryPerformanceFrequency(&frequency);
+
+        for (unsigned cell = 0; cell < cellCount; cell++) {
+            QueryPerformanceCounter(&start);
+            exploreCell(state, counter, cell, 0);
+            QueryPerformanceCounter(&end);
+
+            stats.startCellSeconds[cell] = (double)(end.QuadPart - start.QuadPart) / frequency.QuadPart;
+        }
+    }
+
+    // Scans the board for words until the budget runs out. The cells whose
+    //  letters can be followed by the fewest of their neighbors go first:
+    //  their searches are small, so they turn up the most words for the
+    //  nodes they cost, and many of the words they find would otherwise be
+    //  found later by a much bigger search.
+    bool Board::findWords (const Dictionary * dictionary, FoundWords & result, const SolveBudget & budget) const {
+        unsigned cellCount = width * height;
+
+        result.clear(dictionary->wordCount);
+
+        const Node & root = dictionary->node(0);
+        // Pairs of the number of prefixes each cell starts, and the cell.
+        std::vector<std::pair<unsigned, unsigned> > startCells;
+        startCells.reserve(cellCount);
+
+        for (unsigned cell = 0; cell < cellCount; cell++) {
+            char ch = cellAt(cell);
+            if (!root.contains(ch))
+                continue;
+
+            const Node & node = dictionary->node(root.children[ch - 'a']);
+            unsigned prefixCount = 0;
+            for (unsigned i = 0, count = neighborCount(cell); i < count; i++)
+                prefixCount += node.contains(cellAt(neighbors(cell)[i])) ? 1 : 0;
+
+            startCells.push_back(std::make_pair(prefixCount, cell));
+        }
+
+        std::sort(startCells.begin(), startCells.end());
+
+        SearchState state(this, dictionary, result, 0);
+        BudgetStats limit(budget);
+
+        for (unsigned i = 0; i < startCells.size(); i++) {
+            if (!exploreCell(state, limit, startCells[i].second, 0))
+                return false;
+        }
+
+        return true;
+    }
+
+    // The unit tests compile this file with /clr. Prefetch intrinsics have to
+    //  live in native code, so the interleaved search is compiled unmanaged.
+#ifdef _MANAGED
+#pragma managed(push, off)
+#endif
+
+    // One cell on the path of an interleaved search.
+    struct InterleavedFrame {
+        unsigned cell;
+        NodeIndex node;
+        // The next entry in the cell's neighbor list to try.
+        unsigned nextNeighbor;
+        // Set until the search has looked at the frame's trie node, which
+        //  was only prefetched when the frame was pushed.
+        bool arrived;
+    };
+
+    // A depth first search with an explicit stack, so that it can be
+    //  suspended whenever it is about to touch a new trie node.
+    struct InterleavedSearch {
+        std::vector<InterleavedFrame> stack;
+        std::vector<char> visited;
+    };
+
+    static const size_t CACHE_LINE_SIZE = 64;
+
+    static inline void prefetchNode (const Node & node) {
+        // Nodes aren't aligned to cache lines, so most of them span three lines. Fetch every line
+        //  from the one holding the first byte to the one holding the last.
+        const char * first = (const char *)&node;
+        const char * last = first + sizeof(Node) - 1;
+        for (const char * line = first - ((size_t)first % CACHE_LINE_SIZE); line <= last; line += CACHE_LINE_SIZE)
+            _mm_prefetch(line, _MM_HINT_T0);
+    }
+
+    static void pushInterleavedFrame (InterleavedSearch & search, const Dictionary * dictionary, unsigned cell, NodeIndex node) {
+        InterleavedFrame frame;
+        frame.cell = cell;
+        frame.node = node;
+        frame.nextNeighbor = 0;
+        frame.arrived = false;
+
+        search.stack.push_back(frame);
+        search.visited[cell] = 1;
+        prefetchNode(dictionary->node(node));
+    }
+
+    // Starts a search from the given cell. Returns false if the cell's letter
+    //  doesn't start any words.
+    static bool startInterleavedSearch (InterleavedSearch & search, const Board * board, const Dictionary * dictionary, unsigned cell) {
+        char ch = board->cellAt(cell);
+        const Node & root = dictionary->node(0);
+        if (!root.contains(ch))
+            return false;
+
+        pushInterleavedFrame(search, dictionary, cell, root.children[ch - 'a']);
+        return true;
+    }
+
+    // Runs a search until it pushes a new frame (and so has to wait for its
+    //  trie node) or runs out of paths. Returns false once it is finished.
+    static bool advanceInterleavedSearch (
+        InterleavedSearch & search, const Board * board, const Dictionary * dictionary, FoundWords & result
+    ) {
+        while (!search.stack.empty()) {
+            InterleavedFrame & top = search.stack.back();
+            const Node & node = dictionary->node(top.node);
+
+            if (!top.arrived) {
+                top.arrived = true;
+                if ((search.stack.size() >= MINIMUM_WORD_LENGTH) && node.isValidWord())
+                    result.insert(node.wordId);
+            }
+
+            const unsigned * neighbors = board->neighbors(top.cell);
+            unsigned count = board->neighborCount(top.cell);
+
+            while (top.nextNeighbor < count) {
+                unsigned neighbor = neighbors[top.nextNeighbor++];
+                if (search.visited[neighbor])
+                    continue;
+
+                char ch = board->cellAt(neighbor);
+                if (!node.contains(ch))
+                    continue;
+
+                // top is invalidated once the new frame is pushed.
+                pushInterleavedFrame(search, dictionary, neighbor, node.children[ch - 'a']);
+                return true;
+            }
+
+            search.visited[top.cell] = 0;
+            search.stack.pop_back();
+        }
+
+        return false;
+    }
+
+    void Board::findWordsInterleaved (const Dictionary * dictionary, FoundWords & result, unsigned searchCount) const {
+        result.clear(dictionary->wordCount);
+
+        unsigned cellCount = width * height;
+        if (searchCount < 1)
+            searchCount = 1;
+
+        std::vector<InterleavedSearch> searches(searchCount);
+        for (unsigned i = 0; i < searchCount; i++) {
+            searches[i].stack.reserve(cellCount);
+            searches[i].visited.resize(cellCount, 0);
+        }
+
+        // Each search starts from a different cell. As soon as one finishes it
+        //  picks up the next cell that hasn't been searched yet.
+        unsigned nextCell = 0;
+        std::vector<InterleavedSearch *> active;
+
+        for (unsigned i = 0; i < searchCount; i++) {
+            while ((nextCell < cellCount) && !startInterleavedSearch(searches[i], this, dictionary, nextCell))
+                nextCell += 1;
+
+            if (searches[i].stack.empty())
+                break;
+
+            active.push_back(&searches[i]);
+            nextCell += 1;
+        }
+
+        while (!active.empty()) {
+            for (size_t i = 0; i < active.size(); ) {
+                InterleavedSearch & search = *active[i];
+
+                if (advanceInterleavedSearch(search, this, dictionary, result)) {
+                    i++;
+                    continue;
                 }
 
-                ++iter;
+                while ((nextCell < cellCount) && !startInterleavedSearch(search, this, dictionary, nextCell))
+                    nextCell += 1;
+
+                if (search.stack.empty()) {
+                    active[i] = active.back();
+                    active.pop_back();
+                } else {
+                    nextCell += 1;
+                    i++;
+                }
             }
-            result.insert(w.str());
         }
+    }
 
-        // We potentially explore all eight of a cell's neighbors
-        static CellId potentialNeighbors[] = {
-            CellId(-1, -1), CellId(0, -1), CellId(1, -1),
-            CellId(-1,  0),                CellId(1,  0),
-            CellId(-1,  1), CellId(0,  1), CellId(1,  1)
-        };
+#ifdef _MANAGED
+#pragma managed(pop)
+#endif
+
+    struct AnchoredSearchState {
+        const Board * board;
+        const GaddagDictionary * dictionary;
+        FoundWords & found;
+        std::vector<char> visited;
+        // The cell the current path grew out from, and how many cells the
+        //  path covers in both directions.
+        unsigned anchorCell;
+        unsigned length;
 
-        for (unsigned i = 0; i < 9; i++) {
-            CellId neighborId = cellStack.back() + potentialNeighbors[i];
-            // We don't want to walk off the edges of the board.
-            if (!board->isInBounds(neighborId))
+        AnchoredSearchState (const Board * _board, const GaddagDictionary * _dictionary, FoundWords & _found)
+            : board(_board)
+            , dictionary(_dictionary)
+            , found(_found)
+            , visited(_board->width * _board->height, 0)
+            , anchorCell(0)
+            , length(0) {
+        }
+    };
+
+    // Explores the words that can be finished by extending the end of the
+    //  path, which is at lastCell. nodeIndex is the node for the path so far.
+    static void exploreAfterAnchor (AnchoredSearchState & state, unsigned lastCell, NodeIndex nodeIndex) {
+        const Node & node = state.dictionary->node(nodeIndex);
+
+        if ((state.length >= MINIMUM_WORD_LENGTH) && node.isValidWord())
+            state.found.insert(node.wordId);
+
+        const unsigned * neighbors = state.board->neighbors(lastCell);
+        for (unsigned i = 0, count = state.board->neighborCount(lastCell); node.childLetters && (i < count); i++) {
+            unsigned neighbor = neighbors[i];
+            char ch = state.board->cellAt(neighbor);
+            if (state.visited[neighbor] || !node.contains(ch))
                 continue;
 
-            // Cell already visited during this traversal, so we can't reuse it.
-            if (std::find(cellStack.begin(), cellStack.end(), neighborId) != cellStack.end())
+            state.visited[neighbor] = 1;
+            state.length += 1;
+            exploreAfterAnchor(state, neighbor, node.children[ch - 'a']);
+            state.length -= 1;
+            state.visited[neighbor] = 0;
+        }
+    }
+
+    // Explores the words that can be formed by extending the start of the
+    //  path, which is at firstCell, backward. Whenever the path holds the
+    //  whole beginning of some word, the search also turns around and
+    //  continues forward from the anchor to finish it.
+    static void exploreBeforeAnchor (AnchoredSearchState & state, unsigned firstCell, NodeIndex nodeIndex) {
+        NodeIndex separatorIndex = state.dictionary->separator(nodeIndex);
+        if (separatorIndex)
+            exploreAfterAnchor(state, state.anchorCell, separatorIndex);
+
+        const Node & node = state.dictionary->node(nodeIndex);
+        const unsigned * neighbors = state.board->neighbors(firstCell);
+        for (unsigned i = 0, count = state.board->neighborCount(firstCell); node.childLetters && (i < count); i++) {
+            unsigned neighbor = neighbors[i];
+            char ch = state.board->cellAt(neighbor);
+            if (state.visited[neighbor] || !node.contains(ch))
                 continue;
 
-            cellStack.push_back(neighborId);
-            exploreCellNeighbors(board, dictionary, result, cellStack, nodeStack);
-            cellStack.pop_back();
+            state.visited[neighbor] = 1;
+            state.length += 1;
+            exploreBeforeAnchor(state, neighbor, node.children[ch - 'a']);
+            state.length -= 1;
+            state.visited[neighbor] = 0;
         }
+    }
+
+    // Scans the entire board for words, using every cell as the rarest
+    //  letter of the words around it in turn.
+    void Board::findWords (const GaddagDictionary * dictionary, FoundWords & result) const {
+        result.clear(dictionary->dictionary->wordCount);
+
+        AnchoredSearchState state(this, dictionary, result);
+        const Node & root = dictionary->node(0);
 
-        nodeStack.pop_back();
+        for (unsigned cell = 0, cellCount = width * height; cell < cellCount; cell++) {
+            char ch = cellAt(cell);
+            if (!root.contains(ch))
+                continue;
+
+            state.anchorCell = cell;
+            state.visited[cell] = 1;
+            state.length = 1;
+            exploreBeforeAnchor(state, cell, root.children[ch - 'a']);
+            state.visited[cell] = 0;
+        }
     }
 
-    // Sets up the recursive exploration of a given cell's neighbors for valid
-    //  words. Ensures that given cells are not visited multiple times and also
-    //  ensures that duplicate words are not added to the result set.
-    static void findWordsStartingInCell (
-        const Board * board, const Dictionary * dictionary, 
-        std::set<std::string> & result, CellId startCell
-    ) {
-        std::vector<CellId> cellStack;
-        std::vector<NodeIndex> nodeStack;
-        cellStack.push_back(startCell);
-        nodeStack.push_back(0);
+    unsigned scoreWord (unsigned wordLength) {
+        if (wordLength < MINIMUM_WORD_LENGTH)
+            return 0;
+
+        switch (wordLength) {
+            case 3:
+            case 4:
+                return 1;
+            case 5:
+                return 2;
+            case 6:
+                return 3;
+            case 7:
+                return 5;
+            default:
+                return 11;
+        }
+    }
+
+    // Finds the words on the board and totals up their scores, using only
+    //  their ids and the lengths stored in the dictionary.
+    BoardScore Board::scoreWords (const Dictionary * dictionary, FoundWords & found) const {
+        findWords(dictionary, found);
 
-        exploreCellNeighbors(board, dictionary, result, cellStack, nodeStack);
+        BoardScore result;
+        result.wordCount = found.size();
+        result.score = 0;
+
+        for (size_t i = 0; i < found.ids.size(); i++)
+            result.score += scoreWord(dictionary->wordLength(found.ids[i]));
+
+        return result;
+    }
+
+    BoardScore Board::scoreWords (const Dictionary * dictionary) const {
+        FoundWords found;
+        return scoreWords(dictionary, found);
     }
 
     // Scans the entire board for words using a provided dictionary.
     // Returns a set of the unique words found.
     std::set<std::string> Board::findWords (const Dictionary * dictionary) const {
+        FoundWords found;
+        findWords(dictionary, found);
+
         std::set<std::string> result;
+        for (size_t i = 0; i < found.ids.size(); i++)
+            result.insert(dictionary->word(found.ids[i]));
+
+        return result;
+    }
+
+    struct PrefixSearchState {
+        const Board * board;
+        const Dictionary * dictionary;
+        std::vector<PrefixPath> & prefixes;
+        std::vector<PathIndex> & freePaths;
+        std::vector<std::vector<PathIndex> > & pathsEndingAt;
+        std::vector<unsigned> & pathCounts;
+        // Ids of words that had no paths before this search found one.
+        std::vector<WordId> & appeared;
+
+        PrefixSearchState (
+            const Board * _board, const Dictionary * _dictionary, std::vector<PrefixPath> & _prefixes,
+            std::vector<PathIndex> & _freePaths, std::vector<std::vector<PathIndex> > & _pathsEndingAt,
+            std::vector<unsigned> & _pathCounts, std::vector<WordId> & _appeared
+        )
+            : board(_board)
+            , dictionary(_dictionary)
+            , prefixes(_prefixes)
+            , freePaths(_freePaths)
+            , pathsEndingAt(_pathsEndingAt)
+            , pathCounts(_pathCounts)
+            , appeared(_appeared)
+        {
+        }
+    };
+
+    // Stores a new path in a free slot (or a new one), links it into its
+    //  parent's children and the list of paths ending at its last cell,
+    //  and returns its index.
+    static PathIndex storePrefix (PrefixSearchState & state, PrefixPath & prefix, PathIndex parent) {
+        std::vector<PathIndex> & ending = state.pathsEndingAt[prefix.lastCell];
+
+        prefix.parent = parent;
+        prefix.firstChild = NO_PATH;
+        prefix.previousSibling = NO_PATH;
+        prefix.nextSibling = (parent == NO_PATH) ? NO_PATH : state.prefixes[parent].firstChild;
+        prefix.endingSlot = (unsigned)ending.size();
+
+        PathIndex index;
+        if (state.freePaths.empty()) {
+            index = (PathIndex)state.prefixes.size();
+            state.prefixes.push_back(prefix);
+        } else {
+            index = state.freePaths.back();
+            state.freePaths.pop_back();
+            state.prefixes[index] = prefix;
+        }
+
+        ending.push_back(index);
+
+        if (parent != NO_PATH) {
+            if (prefix.nextSibling != NO_PATH)
+                state.prefixes[prefix.nextSibling].previousSibling = index;
+
+            state.prefixes[parent].firstChild = index;
+        }
+
+        return index;
+    }
+
+    // Extends a path with the given cell, like exploreCell, but remembers
+    //  every prefix it follows and counts every path that spells a word,
+    //  including ones that spell a word found before. A parent of NO_PATH
+    //  starts a new path at the cell.
+    static void collectPrefixes (PrefixSearchState & state, unsigned cell, PathIndex parent) {
+        NodeIndex parentIndex = 0;
+        unsigned __int64 visited = 0;
+        unsigned length = 0;
+
+        if (parent != NO_PATH) {
+            const PrefixPath & parentPath = state.prefixes[parent];
+            parentIndex = parentPath.node;
+            visited = parentPath.cells;
+            length = parentPath.length;
+        }
+
+        char ch = state.board->cellAt(cell);
+        const Node & parentNode = state.dictionary->node(parentIndex);
+        if (!parentNode.contains(ch))
+            return;
+
+        NodeIndex nodeIndex = parentNode.children[ch - 'a'];
+        const Node & node = state.dictionary->node(nodeIndex);
+
+        PrefixPath prefix;
+        prefix.cells = visited | ((unsigned __int64)1 << cell);
+        prefix.node = nodeIndex;
+        prefix.wordId = NO_WORD;
+        prefix.nextLetters = node.childLetters;
+        prefix.lastCell = cell;
+        prefix.length = length + 1;
+
+        if ((prefix.length >= MINIMUM_WORD_LENGTH) && node.isValidWord()) {
+            prefix.wordId = node.wordId;
+            if (state.pathCounts[node.wordId]++ == 0)
+                state.appeared.push_back(node.wordId);
+        }
+
+        PathIndex index = storePrefix(state, prefix, parent);
+
+        // Only follow neighbors whose letter can come next, which saves
+        //  looking up the path and its trie node again for the others.
+        const unsigned * neighbors = state.board->neighbors(cell);
+        for (unsigned i = 0, count = state.board->neighborCount(cell); prefix.nextLetters && (i < count); i++) {
+            unsigned letter = (unsigned)(state.board->cellAt(neighbors[i]) - 'a');
+            if ((letter < 26) && ((prefix.nextLetters >> letter) & 1) && !((prefix.cells >> neighbors[i]) & 1))
+                collectPrefixes(state, neighbors[i], index);
+        }
+    }
+
+    IncrementalSolver::IncrementalSolver (Board * _board, const Dictionary * _dictionary)
+        : board(_board)
+        , dictionary(_dictionary)
+        , pathCounts(_dictionary->wordCount, 0)
+        , uniqueWordCount(0)
+    {
+        unsigned cellCount = board->width * board->height;
+        if (cellCount > 64)
+            throw std::exception("Board is too big to solve incrementally");
+
+        pathsEndingAt.resize(cellCount);
+
+        std::vector<WordId> appeared;
+        PrefixSearchState state(board, dictionary, prefixes, freePaths, pathsEndingAt, pathCounts, appeared);
+
+        for (unsigned cell = 0; cell < cellCount; cell++)
+            collectPrefixes(state, cell, NO_PATH);
 
-        for (unsigned y = 0; y < height; y++) {
-            for (unsigned x = 0; x < width; x++) {
-                findWordsStartingInCell(this, dictionary, result, CellId(x, y));
+        uniqueWordCount = appeared.size();
+    }
+
+    // Forgets the path at root and every path that extends it. Words left
+    //  without any paths are stored in disappeared. The caller takes care of
+    //  root's entry in pathsEndingAt.
+    void IncrementalSolver::removePaths (PathIndex root, std::vector<WordId> & disappeared) {
+        PrefixPath & rootPath = prefixes[root];
+
+        if (rootPath.parent != NO_PATH) {
+            if (rootPath.previousSibling != NO_PATH)
+                prefixes[rootPath.previousSibling].nextSibling = rootPath.nextSibling;
+            else
+                prefixes[rootPath.parent].firstChild = rootPath.nextSibling;
+
+            if (rootPath.nextSibling != NO_PATH)
+                prefixes[rootPath.nextSibling].previousSibling = rootPath.previousSibling;
+        }
+
+        removalStack.push_back(root);
+
+        while (!removalStack.empty()) {
+            PathIndex index = removalStack.back();
+            removalStack.pop_back();
+
+            PrefixPath & prefix = prefixes[index];
+            for (PathIndex child = prefix.firstChild; child != NO_PATH; child = prefixes[child].nextSibling)
+                removalStack.push_back(child);
+
+            if ((prefix.wordId != NO_WORD) && (--pathCounts[prefix.wordId] == 0))
+                disappeared.push_back(prefix.wordId);
+
+            if (index != root) {
+                std::vector<PathIndex> & ending = pathsEndingAt[prefix.lastCell];
+                PathIndex moved = ending.back();
+                ending[prefix.endingSlot] = moved;
+                prefixes[moved].endingSlot = prefix.endingSlot;
+                ending.pop_back();
             }
+
+            // An empty slot spells nothing, which keeps findWords from
+            //  having to check for it.
+            prefix.wordId = NO_WORD;
+            prefix.length = 0;
+            freePaths.push_back(index);
+        }
+    }
+
+    void IncrementalSolver::setCell (
+        unsigned col, unsigned row, char ch, 
+        std::vector<WordId> & added, std::vector<WordId> & removed
+    ) {
+        added.clear();
+        removed.clear();
+
+        ch = tolower(ch);
+        char & cellCharacter = board->at(col, row);
+        if (cellCharacter == ch)
+            return;
+
+        unsigned cell = (row * board->width) + col;
+
+        // Every path through the cell extends exactly one path that ends
+        //  there, so dropping those and everything that extends them drops
+        //  exactly the paths through the cell. Words left without any paths
+        //  might be removed, unless the new letter forms them again.
+        std::vector<WordId> disappeared;
+        removalRoots.assign(pathsEndingAt[cell].begin(), pathsEndingAt[cell].end());
+        pathsEndingAt[cell].clear();
+
+        for (size_t i = 0; i < removalRoots.size(); i++)
+            removePaths(removalRoots[i], disappeared);
+
+        cellCharacter = ch;
+
+        // Every new path either starts at the cell or continues one of the
+        //  remaining paths that ends next to it. A cell that isn't a letter
+        //  can't be part of any word, so there is nothing to find.
+        std::vector<WordId> appeared;
+        if ((ch >= 'a') && (ch <= 'z')) {
+            PrefixSearchState state(board, dictionary, prefixes, freePaths, pathsEndingAt, pathCounts, appeared);
+            unsigned letter = 1 << (ch - 'a');
+
+            const unsigned * neighbors = board->neighbors(cell);
+            for (unsigned i = 0, neighborCount = board->neighborCount(cell); i < neighborCount; i++) {
+                // The search adds the paths it finds to these lists as it goes,
+                //  and those already include the cell.
+                for (size_t j = 0; j < pathsEndingAt[neighbors[i]].size(); j++) {
+                    PathIndex index = pathsEndingAt[neighbors[i]][j];
+                    if ((prefixes[index].nextLetters & letter) && !((prefixes[index].cells >> cell) & 1))
+                        collectPrefixes(state, cell, index);
+                }
+            }
+
+            collectPrefixes(state, cell, NO_PATH);
+        }
+
+        // A word that lost all of its paths and then gained new ones hasn't
+        //  changed.
+        std::sort(disappeared.begin(), disappeared.end());
+
+        for (size_t i = 0; i < disappeared.size(); i++) {
+            if (pathCounts[disappeared[i]] == 0)
+                removed.push_back(disappeared[i]);
+        }
+
+        for (size_t i = 0; i < appeared.size(); i++) {
+            if (!std::binary_search(disappeared.begin(), disappeared.end(), appeared[i]))
+                added.push_back(appeared[i]);
+        }
+
+        uniqueWordCount += added.size();
+        uniqueWordCount -= removed.size();
+    }
+
+    void IncrementalSolver::findWords (FoundWords & result) const {
+        result.clear(dictionary->wordCount);
+
+        for (size_t i = 0; i < prefixes.size(); i++) {
+            if (prefixes[i].wordId != NO_WORD)
+                result.insert(prefixes[i].wordId);
+        }
+    }
+
+    SolveCache::SolveCache (const Dictionary * _dictionary, size_t _memoryLimit)
+        : dictionary(_dictionary)
+        , memoryLimit(_memoryLimit)
+        , memoryUsed(0)
+        , hits(0)
+        , misses(0)
+    {
+    }
+
+    std::string SolveCache::canonicalKey (const Board * board) {
+        unsigned width = board->width, height = board->height;
+        std::string result, candidate;
+
+        // Each orientation is some combination of mirroring horizontally,
+        //  mirroring vertically and swapping rows with columns.
+        for (unsigned orientation = 0; orientation < 8; orientation++) {
+            bool flipX = (orientation & 1) != 0;
+            bool flipY = (orientation & 2) != 0;
+            bool transpose = (orientation & 4) != 0;
+
+            unsigned dimensions[2] = {
+                transpose ? height : width,
+                transpose ? width : height
+            };
+
+            candidate.assign((const char *)dimensions, sizeof(dimensions));
+            candidate.resize(sizeof(dimensions) + (width * height));
+            char * cells = &candidate[sizeof(dimensions)];
+
+            for (unsigned y = 0; y < height; y++) {
+                for (unsigned x = 0; x < width; x++) {
+                    unsigned destX = flipX ? (width - 1 - x) : x;
+                    unsigned destY = flipY ? (height - 1 - y) : y;
+                    if (transpose)
+                        std::swap(destX, destY);
+
+                    cells[(destY * dimensions[0]) + destX] = board->cellAt((y * width) + x);
+                }
+            }
+
+            if ((orientation == 0) || (candidate < result))
+                result.swap(candidate);
         }
 
         return result;
     }
 
+    size_t SolveCache::entrySize (const std::string & key, const Entry & entry) {
+        // The key is stored twice, once in the map and once in the recency
+        //  list, and each entry also costs a map node and a list node.
+        return (key.size() * 2) + (entry.words.size() * sizeof(WordId)) + 64;
+    }
+
+    void SolveCache::findWords (const Board * board, FoundWords & result) {
+        std::string key = canonicalKey(board);
+
+        std::unordered_map<std::string, Entry>::iterator iter = entries.find(key);
+        if (iter != entries.end()) {
+            hits += 1;
+
+            // Move the entry to the front of the recency list.
+            recency.splice(recency.begin(), recency, iter->second.recency);
+
+            result.clear(dictionary->wordCount);
+            const std::vector<WordId> & words = iter->second.words;
+            for (size_t i = 0; i < words.size(); i++)
+                result.insert(words[i]);
+
+            return;
+        }
+
+        misses += 1;
+        board->findWords(dictionary, result);
+
+        recency.push_front(key);
+        Entry & entry = entries[key];
+        entry.words = result.ids;
+        entry.recency = recency.begin();
+        memoryUsed += entrySize(key, entry);
+
+        while ((memoryUsed > memoryLimit) && !recency.empty()) {
+            std::unordered_map<std::string, Entry>::iterator oldest = entries.find(recency.back());
+            memoryUsed -= entrySize(oldest->first, oldest->second);
+            entries.erase(oldest);
+            recency.pop_back();
+        }
+    }
+
+    void SolveCache::clear () {
+        entries.clear();
+        recency.clear();
+        memoryUsed = 0;
+    }
+
     // Given x and y coordinates, returns true if the coordinates are within
     //  the bounds of the board.
     inline bool Board::isInBounds (const CellId & id) const {
@@ -1,24 +1,153 @@
 #include "common.h"
+#include <string.h>
+#include <stdlib.h>
 
 using namespace Boggle;
 
+static void printUsage () {
+    printf("Usage: BoggleSolver [dictionary.txt] [board.txt]\n");
+    printf("       BoggleSolver -score [dictionary.txt] [board.txt] [board.txt ...]\n");
+    printf("       BoggleSolver -stats [dictionary.txt] [board.txt]\n");
+    printf("       BoggleSolver -optimize [dictionary.txt] [width] [height] [chains] [iterations] [seed]\n");
+    printf("With -score, only the number of words on each board and its total score are printed.\n");
+    printf("With -stats, counts of the work done by the search are printed after the words.\n");
+    printf("With -optimize, the best board found by each search chain is printed, highest scoring first.\n");
+}
+
+static void printStats (const Board * board, const SolveStats & stats) {
+    fprintf(stderr, "// Trie nodes visited: %llu\n", stats.nodesVisited);
+    fprintf(stderr, "// Dead ends: %llu\n", stats.deadEnds);
+    fprintf(stderr, "// Revisits rejected: %llu\n", stats.revisitsRejected);
+
+    fprintf(stderr, "// Nodes visited by prefix length:\n");
+    for (unsigned i = 0; i < stats.depthCounts.size(); i++) {
+        if (stats.depthCounts[i])
+            fprintf(stderr, "//  %2u: %llu\n", i + 1, stats.depthCounts[i]);
+    }
+
+    fprintf(stderr, "// Microseconds spent on paths starting from each cell:\n");
+    for (unsigned row = 0; row < board->height; row++) {
+        fprintf(stderr, "// ");
+        for (unsigned col = 0; col < board->width; col++)
+            fprintf(stderr, " %8.1f", stats.startCellSeconds[(row * board->width) + col] * 1000000.0);
+        fprintf(stderr, "\n");
+    }
+}
+
+// Prints the word count and score of each board, reusing one set of found
+//  words for all of them.
+static void scoreBoards (const Dictionary * dictionary, int boardCount, const char * boardPaths[]) {
+    FoundWords found;
+
+    for (int i = 0; i < boardCount; i++) {
+        Board * board = Board::fromFile(boardPaths[i]);
+
+        try {
+            BoardScore score = board->scoreWords(dictionary, found);
+            printf("%s: %u word(s), score %u\n", boardPaths[i], score.wordCount, score.score);
+        } catch (...) {
+            delete board;
+            throw;
+        }
+
+        delete board;
+    }
+}
+
+// Searches for high scoring boards using the settings given on the command
+//  line (width, height, and optionally chains, iterations and seed), and
+//  prints the best board from each chain.
+static void printOptimizedBoards (const Dictionary * dictionary, int argc, const char * argv[]) {
+    int width = atoi(argv[0]), height = atoi(argv[1]);
+    if ((width <= 0) || (height <= 0))
+        throw std::exception("Invalid board size");
+
+    OptimizerSettings settings(width, height);
+
+    if (argc > 2) {
+        int chainCount = atoi(argv[2]);
+        if (chainCount <= 0)
+            throw std::exception("Invalid number of chains");
+
+        settings.chainCount = chainCount;
+    }
+
+    if (argc > 3) {
+        int iterations = atoi(argv[3]);
+        if (iterations < 0)
+            throw std::exception("Invalid number of iterations");
+
+        settings.iterations = iterations;
+    }
+
+    if (argc > 4)
+        settings.seed = strtoul(argv[4], 0, 10);
+
+    fprintf(stderr, "// Optimizing %u %ux%u board(s) ... ", settings.chainCount, settings.width, settings.height);
+    std::vector<ScoredBoard> boards = optimizeBoards(dictionary, settings);
+    fprintf(stderr, "done.\n");
+
+    for (unsigned i = 0; i < boards.size(); i++) {
+        printf("// Seed %u: %u word(s), score %u\n", boards[i].seed, boards[i].score.wordCount, boards[i].score.score);
+        printf("%s\n", boards[i].characters.c_str());
+    }
+}
+
 int main (int argc, const char* argv[]) {
-    if (argc != 3) {
-        printf("Usage: BoggleSolver [dictionary.txt] [board.txt]\n");
+    bool scoreOnly = (argc > 1) && !strcmp(argv[1], "-score");
+    bool showStats = (argc > 1) && !strcmp(argv[1], "-stats");
+    bool optimize = (argc > 1) && !strcmp(argv[1], "-optimize");
+
+    bool validArguments;
+    if (scoreOnly)
+        validArguments = (argc >= 4);
+    else if (showStats)
+        validArguments = (argc == 4);
+    else if (optimize)
+        validArguments = (argc >= 5) && (argc <= 8);
+    else
+        validArguments = (argc == 3);
+
+    if (!validArguments) {
+        printUsage();
         return 1;
     }
 
+    if (scoreOnly || showStats || optimize) {
+        argv += 1;
+        argc -= 1;
+    }
+
     try {
         fprintf(stderr, "// Loading dictionary from '%s' ... ", argv[1]);
         Dictionary * dictionary = new Dictionary(argv[1]);
         fprintf(stderr, "done.\n");
 
+        if (scoreOnly) {
+            scoreBoards(dictionary, argc - 2, argv + 2);
+            return 0;
+        } else if (optimize) {
+            printOptimizedBoards(dictionary, argc - 2, argv + 2);
+            return 0;
+        }
+
         fprintf(stderr, "// Loading board from '%s' ... ", argv[2]);
         Board * board = Board::fromFile(argv[2]);
         fprintf(stderr, "done.\n");
 
         fprintf(stderr, "// Finding words ... ");
-        std::set<std::string> words = board->findWords(dictionary);
+        std::set<std::string> words;
+        SolveStats stats;
+
+        if (showStats) {
+            FoundWords found;
+            board->findWords(dictionary, found, stats);
+
+            for (unsigned i = 0; i < found.size(); i++)
+                words.insert(dictionary->word(found.ids[i]));
+        } else {
+            words = board->findWords(dictionary);
+        }
 
         fprintf(stderr, "%d word(s) found.\n", words.size());
         std::set<std::string>::iterator iter = words.begin();
@@ -26,6 +155,9 @@ int main (int argc, const char* argv[]) {
             printf("%s\n", iter->c_str());
             ++iter;
         }
+
+        if (showStats)
+            printStats(board, stats);
     } catch (std::exception exc) {
         printf("An error occurred: %s\n", exc.what());
         return 1;
@@ -1,86 +1,458 @@
 #include "common.h"
 #include "string.h"
+#include <stdio.h>
 #include <exception>
+#include <intrin.h>
+#include <emmintrin.h>
+#include <tmmintrin.h>
 
-// Efficiently reverse the order of words within a null-terminated string, using as little additional storage space as possible.
-// To eliminate the need for temporary storage to track word lengths, we replace the spaces between words with the lengths of
-//  words. This means that having a word longer than 255 characters will cause this algorithm to fail. This could be fixed by 
-//  using temporary storage, but for UTF-16 strings (As used on Win32, among other places) the word length limit would go up 
-//  to 65k :)
+// The unit tests compile this file with /clr. Intrinsics have to live in native code, so we switch
+//  off managed code generation for the rest of the file.
+#ifdef _MANAGED
+#pragma managed(push, off)
+#endif
+
+// Reverses a sequence of characters one at a time. Used for short sequences and for the leftovers
+//  in the middle of a sequence once the vectorized loops run out of whole blocks.
+template <typename TChar>
+static void reverse_characters_scalar (TChar * chars, size_t count) {
+    const size_t steps = count / 2;
+
+    for (size_t i = 0; i < steps; i++) {
+        const size_t j = (count - 1) - i;
+        TChar temp = chars[i];
+        chars[i] = chars[j];
+        chars[j] = temp;
+    }
+}
+
+// SSE2 has no byte shuffle, so we swap the bytes within each 16-bit lane and then reverse the
+//  order of the lanes.
+struct sse2_byte_reverser {
+    typedef char element;
+
+    static inline __m128i reverse (__m128i v) {
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+        v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+        return _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+    }
+};
+
+struct ssse3_byte_reverser {
+    typedef char element;
+
+    static inline __m128i reverse (__m128i v) {
+        const __m128i mask = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+        return _mm_shuffle_epi8(v, mask);
+    }
+};
+
+// The 16-bit equivalents, used for UTF-16 strings.
+struct sse2_word_reverser {
+    typedef wchar_t element;
+
+    static inline __m128i reverse (__m128i v) {
+        v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+        v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+        return _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+    }
+};
+
+struct ssse3_word_reverser {
+    typedef wchar_t element;
+
+    static inline __m128i reverse (__m128i v) {
+        const __m128i mask = _mm_setr_epi8(14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1);
+        return _mm_shuffle_epi8(v, mask);
+    }
+};
+
+// Reverses a sequence of characters 16 bytes at a time by swapping a block from the front with a
+//  block from the back, reversing each of them on the way. Once the two ends are less than two
+//  blocks apart, the remaining characters are reversed one at a time.
+template <typename TReverser>
+static void reverse_characters_vectorized (typename TReverser::element * chars, size_t count) {
+    typedef typename TReverser::element TChar;
+    const size_t blockLength = sizeof(__m128i) / sizeof(TChar);
+
+    TChar * front = chars;
+    TChar * back = chars + count;
+
+    while ((size_t)(back - front) >= (blockLength * 2)) {
+        back -= blockLength;
+
+        const __m128i frontBlock = _mm_loadu_si128((const __m128i *)front);
+        const __m128i backBlock = _mm_loadu_si128((const __m128i *)back);
+        _mm_storeu_si128((__m128i *)front, TReverser::reverse(backBlock));
+        _mm_storeu_si128((__m128i *)back, TReverser::reverse(frontBlock));
+
+        front += blockLength;
+    }
+
+    reverse_characters_scalar(front, back - front);
+}
+
+// Spaces and tabs separate words. Any run of separators is preserved (mirrored) between the reversed words.
+template <typename TChar>
+static inline bool is_word_separator (TChar ch) {
+    return (ch == ' ') || (ch == '\t');
+}
+
+static inline unsigned long separator_mask (__m128i block) {
+    const __m128i spaces = _mm_set1_epi8(' ');
+    const __m128i tabs = _mm_set1_epi8('\t');
+
+    return (unsigned long)_mm_movemask_epi8(
+        _mm_or_si128(_mm_cmpeq_epi8(block, spaces), _mm_cmpeq_epi8(block, tabs))
+    );
+}
+
+// Reverses the order of words by reversing the whole sentence and then reversing each word. The word
+//  boundaries are found with a forward scan, so words may be of any length and no extra storage is needed.
+// Since every word ends up reversed twice, its characters come out in their original order; this means
+//  multi-byte UTF-8 sequences and UTF-16 surrogate pairs inside words survive intact.
+template <typename TChar>
+static void reverse_words_two_pass (TChar * sentence, size_t sentenceLength, void (*reverse) (TChar *, size_t)) {
+    reverse(sentence, sentenceLength);
+
+    TChar * wordStart = sentence;
+    TChar * const end = sentence + sentenceLength;
+
+    for (TChar * p = sentence; p < end; p++) {
+        if (is_word_separator(*p)) {
+            reverse(wordStart, p - wordStart);
+            wordStart = p + 1;
+        }
+    }
+
+    reverse(wordStart, end - wordStart);
+}
+
+static void reverse_words_scalar (char * sentence, size_t sentenceLength) {
+    reverse_words_two_pass(sentence, sentenceLength, reverse_characters_scalar<char>);
+}
+
+// The same algorithm as reverse_words_two_pass, fused into a single pass over the sentence. Every time a
+//  block from each end has been swapped into its final position we already hold both reversed blocks in
+//  registers, so we find the separators in them right away and reverse every word that is now complete
+//  while it is still in cache. Words are completed from the front towards the middle and from the back
+//  towards the middle; whatever is left over is finished once the two ends meet.
+template <typename TReverser>
+static void reverse_words_vectorized (char * sentence, size_t sentenceLength) {
+    char * front = sentence;
+    char * back = sentence + sentenceLength;
+    // The start of the first front word and the end of the last back word that have not been reversed yet.
+    char * frontWordStart = front;
+    char * backWordEnd = back;
+    unsigned long bit;
+
+    while ((size_t)(back - front) >= 32) {
+        back -= 16;
+
+        const __m128i frontBlock = TReverser::reverse(_mm_loadu_si128((const __m128i *)back));
+        const __m128i backBlock = TReverser::reverse(_mm_loadu_si128((const __m128i *)front));
+        _mm_storeu_si128((__m128i *)front, frontBlock);
+        _mm_storeu_si128((__m128i *)back, backBlock);
+
+        // Separators in the front block complete words in ascending order...
+        unsigned long mask = separator_mask(frontBlock);
+        while (_BitScanForward(&bit, mask)) {
+            char * const separator = front + bit;
+            reverse_characters_vectorized<TReverser>(frontWordStart, separator - frontWordStart);
+            frontWordStart = separator + 1;
+            mask &= mask - 1;
+        }
+
+        // ...and separators in the back block complete them in descending order.
+        mask = separator_mask(backBlock);
+        while (_BitScanReverse(&bit, mask)) {
+            char * const separator = back + bit;
+            reverse_characters_vectorized<TReverser>(separator + 1, backWordEnd - (separator + 1));
+            backWordEnd = separator;
+            mask &= ~(1UL << bit);
+        }
+
+        front += 16;
+    }
+
+    // Reverse the middle section, which is less than two blocks long, and then finish every word between
+    //  the front and back words we have not completed yet.
+    reverse_characters_scalar(front, back - front);
+
+    for (char * p = front; p < back; p++) {
+        if (is_word_separator(*p)) {
+            reverse_characters_vectorized<TReverser>(frontWordStart, p - frontWordStart);
+            frontWordStart = p + 1;
+        }
+    }
+
+    reverse_characters_vectorized<TReverser>(frontWordStart, backWordEnd - frontWordStart);
+}
+
+typedef void (*reverse_characters_function) (char *, size_t);
+typedef void (*reverse_words_function) (char *, size_t);
+typedef void (*reverse_wide_characters_function) (wchar_t *, size_t);
+
+// The level is selected lazily on first use. Detection always produces the same answer, so it does not
+//  matter if two threads race to perform it.
+static bool simdLevelSelected = false;
+static simd_level currentSimdLevel = SIMD_NONE;
+static reverse_characters_function reverseCharacters = reverse_characters_scalar;
+static reverse_words_function reverseWords = reverse_words_scalar;
+static reverse_wide_characters_function reverseWideCharacters = reverse_characters_scalar;
+
+simd_level detect_simd_level () {
+    int info[4];
+
+    __cpuid(info, 0);
+    if (info[0] < 1)
+        return SIMD_NONE;
+
+    __cpuid(info, 1);
+    // ECX bit 9 indicates SSSE3, EDX bit 26 indicates SSE2
+    if (info[2] & (1 << 9))
+        return SIMD_SSSE3;
+    else if (info[3] & (1 << 26))
+        return SIMD_SSE2;
+    else
+        return SIMD_NONE;
+}
+
+void set_simd_level (simd_level level) {
+    const simd_level supported = detect_simd_level();
+    if (level > supported)
+        level = supported;
+
+    switch (level) {
+        case SIMD_SSSE3:
+            reverseCharacters = reverse_characters_vectorized<ssse3_byte_reverser>;
+            reverseWords = reverse_words_vectorized<ssse3_byte_reverser>;
+            reverseWideCharacters = reverse_characters_vectorized<ssse3_word_reverser>;
+            break;
+        case SIMD_SSE2:
+            reverseCharacters = reverse_characters_vectorized<sse2_byte_reverser>;
+            reverseWords = reverse_words_vectorized<sse2_byte_reverser>;
+            reverseWideCharacters = reverse_characters_vectorized<sse2_word_reverser>;
+            break;
+        default:
+            reverseCharacters = reverse_characters_scalar;
+            reverseWords = reverse_words_scalar;
+            reverseWideCharacters = reverse_characters_scalar;
+            break;
+    }
+
+    currentSimdLevel = level;
+    simdLevelSelected = true;
+}
+
+simd_level get_simd_level () {
+    if (!simdLevelSelected)
+        set_simd_level(detect_simd_level());
+
+    return currentSimdLevel;
+}
+
+// Efficiently reverse the order of words within a null-terminated string, in-place and without any additional
+//  storage. Words are separated by spaces or tabs and may be of any length. UTF-8 text is handled correctly,
+//  since the bytes within each word keep their original order.
 void reverse_words (char * sentence) {
-    const size_t sentenceLength = strlen(sentence);
-    size_t firstWordLength;
-
-    // First we reverse the entire string so that the words are in the opposite of their original order.
-    // While doing this we also identify the location of the break between each word, and we replace
-    //  the space separating the words with a byte representing the length of the next word.
-    {
-        const size_t numSwaps = sentenceLength / 2;
-        unsigned currentWordStart = 0;
-        size_t currentWordLength = 0;
-
-        for (unsigned i = 0; i < sentenceLength; i++) {
-            char ch = sentence[i];
-
-            if (i < numSwaps) {
-                const unsigned j = (sentenceLength - 1) - i;
-                sentence[i] = sentence[j];
-                sentence[j] = ch;
-                ch = sentence[i];
-            }
+    get_simd_level();
+
+    reverseWords(sentence, strlen(sentence));
+}
 
-            if (ch == ' ') {
-                if (currentWordLength > 0xFF)
-                    throw std::exception("Found a word with more than 255 characters in it.");
-                
-                // We can't store the length of the first word inside the string, so we store it in a local.
-                if (currentWordStart == 0)
-                    firstWordLength = currentWordLength;
-                else
-                    sentence[currentWordStart] = (char)currentWordLength;
-
-                currentWordStart = i;
-                currentWordLength = 0;
-            } else {
-                currentWordLength++;
+// Reverse a sequence of characters in-place
+void reverse_characters_in_place (char * chars, size_t count) {
+    get_simd_level();
+
+    reverseCharacters(chars, count);
+}
+
+// Reversing the bytes of a UTF-8 string would leave every multi-byte sequence backwards, so before we do that
+//  we reverse the bytes of each multi-byte sequence; the second reversal then puts them back in order. A
+//  sequence is a lead byte followed by up to three continuation bytes (10xxxxxx). Malformed input is never
+//  rejected, the bytes are just grouped the same way.
+// When SSE2 is available we check 16 bytes at a time for bytes with the high bit set and skip straight to
+//  the first one, so pure ASCII text only pays for one extra read-only pass.
+void reverse_utf8_characters_in_place (char * chars, size_t count) {
+    const simd_level level = get_simd_level();
+    size_t i = 0;
+
+    while (i < count) {
+        if ((level >= SIMD_SSE2) && ((i + 16) <= count)) {
+            const unsigned long mask = (unsigned long)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)(chars + i)));
+            unsigned long bit;
+
+            if (!_BitScanForward(&bit, mask)) {
+                i += 16;
+                continue;
             }
+
+            i += bit;
+        } else if (((unsigned char)chars[i]) < 0x80) {
+            i++;
+            continue;
         }
 
-        // The sentence probably doesn't have a trailing space, so we need to write out the length of the last word.
-        if (currentWordStart == 0)
-            firstWordLength = currentWordLength;
-        else
-            sentence[currentWordStart] = (char)currentWordLength;
+        size_t sequenceEnd = i + 1;
+        while ((sequenceEnd < count) && ((sequenceEnd - i) < 4) && ((chars[sequenceEnd] & 0xC0) == 0x80))
+            sequenceEnd++;
+
+        reverse_characters_scalar(chars + i, sequenceEnd - i);
+        i = sequenceEnd;
     }
 
-    // Now we do a second pass through the sentence, reversing each individual word. The length information that
-    //  we computed during the first pass will simplify this.
-    {
-        unsigned i = 0;
-        size_t currentWordLength = firstWordLength;
+    reverseCharacters(chars, count);
+}
 
-        while ((i + currentWordLength) <= sentenceLength) {
-            reverse_characters_in_place(sentence + i, currentWordLength);
+static inline bool is_high_surrogate (wchar_t ch) {
+    return (ch >= 0xD800) && (ch <= 0xDBFF);
+}
 
-            i += currentWordLength;
-            if (i >= sentenceLength)
-                break;
+static inline bool is_low_surrogate (wchar_t ch) {
+    return (ch >= 0xDC00) && (ch <= 0xDFFF);
+}
+
+// Reverses a sequence of UTF-16 characters in-place, keeping surrogate pairs in order. This works the same
+//  way as reverse_utf8_characters_in_place: we swap the two halves of every surrogate pair and then reverse
+//  everything. Blocks of 8 characters that contain no surrogates at all are skipped with SSE2.
+void reverse_characters_in_place (wchar_t * chars, size_t count) {
+    const simd_level level = get_simd_level();
+    size_t i = 0;
+
+    while ((i + 1) < count) {
+        if ((level >= SIMD_SSE2) && ((i + 8) <= count)) {
+            // The constants are built in here so that nothing runs SSE2 instructions without SSE2.
+            const __m128i surrogateMask = _mm_set1_epi16((short)0xF800);
+            const __m128i surrogateBits = _mm_set1_epi16((short)0xD800);
+            const __m128i block = _mm_loadu_si128((const __m128i *)(chars + i));
+            const unsigned long mask = (unsigned long)_mm_movemask_epi8(
+                _mm_cmpeq_epi16(_mm_and_si128(block, surrogateMask), surrogateBits)
+            );
+            unsigned long bit;
+
+            if (!_BitScanForward(&bit, mask)) {
+                i += 8;
+                continue;
+            }
+
+            // Each character covers two bits of the mask.
+            i += bit / 2;
+        }
 
-            currentWordLength = (size_t)sentence[i];
-            sentence[i] = ' ';
+        if (((i + 1) < count) && is_high_surrogate(chars[i]) && is_low_surrogate(chars[i + 1])) {
+            reverse_characters_scalar(chars + i, 2);
+            i += 2;
+        } else {
             i++;
         }
     }
+
+    reverseWideCharacters(chars, count);
 }
 
-// Reverse a sequence of characters in-place
-void reverse_characters_in_place (char * chars, size_t count) {
-    const size_t steps = count / 2;
+// The UTF-16 version of reverse_words. Surrogate pairs inside words keep their order for the same reason
+//  multi-byte UTF-8 sequences do.
+void reverse_words (wchar_t * sentence) {
+    get_simd_level();
 
-    for (unsigned i = 0; i < steps; i++) {
-        const unsigned j = (count - 1) - i;
-        char temp = chars[i];
-        chars[i] = chars[j];
-        chars[j] = temp;
+    reverse_words_two_pass(sentence, wcslen(sentence), reverseWideCharacters);
+}
+
+// Reads count bytes starting at offset from a seekable stream into buffer.
+static void read_stream_range (FILE * stream, __int64 offset, char * buffer, size_t count) {
+    if (_fseeki64(stream, offset, SEEK_SET))
+        throw std::exception("Failed to seek within input");
+
+    if (fread(buffer, 1, count, stream) != count)
+        throw std::exception("Failed to read input");
+}
+
+static void write_stream (FILE * stream, const char * buffer, size_t count) {
+    if (fwrite(buffer, 1, count, stream) != count)
+        throw std::exception("Failed to write output");
+}
+
+// Writes the word occupying [wordStart, wordEnd) of the input to output. The part of it that lies within
+//  the block currently in memory is written from there, and the rest is read back from the input.
+static void write_stream_word (
+    FILE * input, FILE * output, const char * block, __int64 blockStart, __int64 blockEnd,
+    char * spill, size_t spillSize, __int64 wordStart, __int64 wordEnd
+) {
+    const __int64 inBlockEnd = (wordEnd < blockEnd) ? wordEnd : blockEnd;
+    write_stream(output, block + (wordStart - blockStart), (size_t)(inBlockEnd - wordStart));
+
+    for (__int64 offset = inBlockEnd; offset < wordEnd; ) {
+        const __int64 remaining = wordEnd - offset;
+        const size_t count = (remaining > (__int64)spillSize) ? spillSize : (size_t)remaining;
+
+        read_stream_range(input, offset, spill, count);
+        write_stream(output, spill, count);
+        offset += count;
     }
-}
\ No newline at end of file
+}
+
+// Reverses the order of the words in everything readable from input and writes the result to output.
+// The result is the same as reading the entire input into memory and calling reverse_words on it, but
+//  we never hold more than two blocks of the input in memory at once, so it works on files larger than
+//  the address space. The input must be seekable.
+// The input is read in blocks starting from its end. Scanning each block backwards, every separator we
+//  find completes the word that follows it, which we can write out straight away; separators themselves
+//  are written out as we encounter them, which mirrors each run of them the same way reverse_words does.
+//  A word that straddles the end of the current block is finished by reading its remainder back from the
+//  input, so words may be of any length.
+void reverse_words_in_stream (FILE * input, FILE * output, size_t blockSize) {
+    if (blockSize == 0)
+        throw std::exception("Block size must be greater than zero");
+
+    if (_fseeki64(input, 0, SEEK_END))
+        throw std::exception("Failed to seek within input");
+
+    const __int64 inputLength = _ftelli64(input);
+    if (inputLength < 0)
+        throw std::exception("Failed to get input length");
+
+    char * block = new char[blockSize];
+    char * spill = 0;
+
+    try {
+        spill = new char[blockSize];
+
+        // The offset one past the end of the word we are currently scanning backwards through.
+        __int64 wordEnd = inputLength;
+        __int64 blockStart = inputLength, blockEnd;
+
+        do {
+            blockEnd = blockStart;
+            blockStart = (blockEnd > (__int64)blockSize) ? (blockEnd - blockSize) : 0;
+            read_stream_range(input, blockStart, block, (size_t)(blockEnd - blockStart));
+
+            for (__int64 i = blockEnd; i > blockStart; ) {
+                --i;
+                const char ch = block[i - blockStart];
+
+                if (is_word_separator(ch)) {
+                    write_stream_word(input, output, block, blockStart, blockEnd, spill, blockSize, i + 1, wordEnd);
+                    write_stream(output, &ch, 1);
+                    wordEnd = i;
+                }
+            }
+        } while (blockStart > 0);
+
+        // The first word in the input is not preceded by a separator, so we still need to write it out. The
+        //  last block we read started at offset 0 and is still in memory.
+        write_stream_word(input, output, block, 0, blockEnd, spill, blockSize, 0, wordEnd);
+    } catch (...) {
+        delete[] block;
+        delete[] spill;
+        throw;
+    }
+
+    delete[] block;
+    delete[] spill;
+}
+
+#ifdef _MANAGED
+#pragma managed(pop)
+#endif
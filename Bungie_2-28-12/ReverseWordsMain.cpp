@@ -0,0 +1,57 @@
+#include "common.h"
+#include <io.h>
+#include <fcntl.h>
+#include <string.h>
+#include <stdlib.h>
+
+int main (int argc, const char* argv[]) {
+    if ((argc < 2) || (argc > 4)) {
+        printf("Usage: ReverseWords [input.txt] [output.txt] [blockSizeKb]\n");
+        printf("If no output file (or '-') is given, the result is written to standard output.\n");
+        return 1;
+    }
+
+    FILE * input = 0, * output = stdout;
+    size_t blockSize = 1024 * 1024;
+
+    if (argc > 3) {
+        int blockSizeKb = atoi(argv[3]);
+        if (blockSizeKb <= 0) {
+            printf("Invalid block size '%s'\n", argv[3]);
+            return 1;
+        }
+
+        blockSize = (size_t)blockSizeKb * 1024;
+    }
+
+    try {
+        input = fopen(argv[1], "rb");
+        if (!input)
+            throw std::exception("Failed to open input file");
+
+        if ((argc > 2) && strcmp(argv[2], "-")) {
+            output = fopen(argv[2], "wb");
+            if (!output)
+                throw std::exception("Failed to open output file");
+        } else {
+            // Don't let the CRT turn the input's newlines into CRLFs.
+            _setmode(_fileno(stdout), _O_BINARY);
+        }
+
+        reverse_words_in_stream(input, output, blockSize);
+
+        fclose(input);
+        if (output != stdout)
+            fclose(output);
+    } catch (std::exception exc) {
+        if (input)
+            fclose(input);
+        if (output && (output != stdout))
+            fclose(output);
+
+        fprintf(stderr, "An error occurred: %s\n", exc.what());
+        return 1;
+    }
+
+    return 0;
+}
\ No newline at end of file
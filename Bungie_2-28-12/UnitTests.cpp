@@ -11,6 +11,30 @@ using namespace Runtime::InteropServices;
 
 namespace Test
 {
+    // Records the first few words a Boggle solve reports, then asks it to stop.
+    class StoppingWordSink : public Boggle::WordSink {
+    public:
+        std::vector<Boggle::WordId> ids;
+        std::vector<std::string> spelledWords;
+        const Boggle::Board * board;
+        size_t limit;
+
+        StoppingWordSink (const Boggle::Board * _board, size_t _limit)
+            : board(_board)
+            , limit(_limit) {
+        }
+
+        virtual bool wordFound (Boggle::WordId id, const Boggle::CellId * path, size_t length) {
+            std::string word;
+            for (size_t i = 0; i < length; i++)
+                word += board->at(path[i].x, path[i].y);
+
+            ids.push_back(id);
+            spelledWords.push_back(word);
+            return ids.size() < limit;
+        }
+    };
+
 	[TestClass]
 	public ref class UnitTests
 	{
@@ -139,16 +163,231 @@ namespace Test
 		};
 
 		[TestMethod]
-		void ReverseWordsThrowsIfAWordIsTooLong() {
-			char buffer[1024] = "word1 abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz word3 word4";
+		void ReverseWordsHandlesWordsLongerThan255Characters() {
+            const char * alphabet = "abcdefghijklmnopqrstuvwxyz";
+            char buffer[1024] = "word1 ";
+            char expected[1024] = "word4 word3 ";
+
+            for (unsigned i = 0; i < 10; i++)
+                strcat(buffer, alphabet);
+            strcat(buffer, " word3 word4");
+
+            for (unsigned i = 0; i < 10; i++)
+                strcat(expected, alphabet);
+            strcat(expected, " word1");
+
+            reverse_words(buffer);
+
+            Assert::AreEqual(
+                gcnew String(expected),
+                gcnew String(buffer)
+            );
+		};
+
+		[TestMethod]
+		void ReverseWordsHandlesTabsAndRepeatedSpaces() {
+			char buffer[256]   = "  one\ttwo   three \t four ";
+            char expected[256] = " four \t three   two\tone  ";
+
+            reverse_words(buffer);
+
+            Assert::AreEqual(
+                gcnew String(expected),
+                gcnew String(buffer)
+            );
+		};
+
+        // Builds a sentence of pseudo-random words separated by runs of spaces and tabs, with the occasional
+        //  word longer than 255 characters, that is long enough to exercise the vectorized loops as well as
+        //  their scalar tails.
+        char * MakeLongSentence(size_t length) {
+            char * result = new char[length + 1];
+            unsigned seed = 12345;
+
+            for (size_t i = 0; i < length; i++) {
+                seed = (seed * 1103515245) + 12345;
+                unsigned r = (seed >> 16) % 4096;
+
+                if (r < 4)
+                    // Start a long word, which will be cut short if we run out of room.
+                    for (unsigned j = 0; (j < 300) && (i + 1 < length); j++)
+                        result[i++] = 'z';
+
+                if ((r % 64) < 6)
+                    result[i] = ' ';
+                else if ((r % 64) < 8)
+                    result[i] = '\t';
+                else
+                    result[i] = (char)('a' + (r % 26));
+            }
+
+            result[length] = '\0';
+            return result;
+        }
+
+		[TestMethod]
+		void ReverseCharactersInPlaceGivesSameResultAtEverySimdLevel() {
+            const simd_level originalLevel = get_simd_level();
+            char source[128], expected[128], actual[128];
+
+            for (unsigned i = 0; i < sizeof(source); i++)
+                source[i] = (char)(i + 1);
 
             try {
-                reverse_words(buffer);
-                Assert::Fail("Should have thrown a C++ exception");
-            } catch (std::exception exc) {
+                for (size_t count = 0; count <= sizeof(source); count++) {
+                    for (size_t i = 0; i < count; i++)
+                        expected[i] = source[count - 1 - i];
+
+                    for (int level = SIMD_NONE; level <= SIMD_SSSE3; level++) {
+                        set_simd_level((simd_level)level);
+                        memcpy(actual, source, count);
+                        reverse_characters_in_place(actual, count);
+
+                        Assert::AreEqual(0, memcmp(expected, actual, count));
+                    }
+                }
+            } finally {
+                set_simd_level(originalLevel);
+            }
+		};
+
+		[TestMethod]
+		void ReverseWordsGivesSameResultAtEverySimdLevel() {
+            const simd_level originalLevel = get_simd_level();
+            const size_t length = 4099;
+            char * source = MakeLongSentence(length);
+            char * expected = new char[length + 1];
+            char * actual = new char[length + 1];
+
+            try {
+                set_simd_level(SIMD_NONE);
+                memcpy(expected, source, length + 1);
+                reverse_words(expected);
+
+                for (int level = SIMD_SSE2; level <= SIMD_SSSE3; level++) {
+                    set_simd_level((simd_level)level);
+                    memcpy(actual, source, length + 1);
+                    reverse_words(actual);
+
+                    Assert::AreEqual(gcnew String(expected), gcnew String(actual));
+                }
+            } finally {
+                set_simd_level(originalLevel);
+                delete[] source;
+                delete[] expected;
+                delete[] actual;
             }
 		};
 
+        // Not really a test: reports the throughput of reverse_words at each SIMD level on a
+        //  multi-megabyte buffer.
+		[TestMethod]
+		void ReverseWordsThroughputBenchmark() {
+            const simd_level originalLevel = get_simd_level();
+            const size_t length = 16 * 1024 * 1024;
+            const int iterations = 8;
+            char * buffer = MakeLongSentence(length);
+
+            try {
+                for (int level = SIMD_NONE; level <= SIMD_SSSE3; level++) {
+                    set_simd_level((simd_level)level);
+                    if (get_simd_level() != level)
+                        continue;
+
+                    Diagnostics::Stopwatch ^ stopwatch = Diagnostics::Stopwatch::StartNew();
+                    for (int i = 0; i < iterations; i++)
+                        reverse_words(buffer);
+                    stopwatch->Stop();
+
+                    double megabytesPerSecond = (length * (double)iterations) / (1024.0 * 1024.0) / stopwatch->Elapsed.TotalSeconds;
+                    TestContext->WriteLine("reverse_words at SIMD level {0}: {1:F1} MB/s", level, megabytesPerSecond);
+                }
+            } finally {
+                set_simd_level(originalLevel);
+                delete[] buffer;
+            }
+		};
+
+		[TestMethod]
+		void ReverseWordsInStreamMatchesReverseWords() {
+            const size_t length = 4099;
+            char * expected = MakeLongSentence(length);
+            char * actual = new char[length + 1];
+            FILE * input = tmpfile();
+            FILE * output = tmpfile();
+
+            try {
+                Assert::AreEqual(length, fwrite(expected, 1, length, input));
+                reverse_words(expected);
+
+                // Use blocks much smaller than the longest words to exercise reading them back from the input.
+                reverse_words_in_stream(input, output, 64);
+
+                rewind(output);
+                Assert::AreEqual(length, fread(actual, 1, length + 1, output));
+                actual[length] = '\0';
+
+                Assert::AreEqual(gcnew String(expected), gcnew String(actual));
+            } finally {
+                fclose(input);
+                fclose(output);
+                delete[] expected;
+                delete[] actual;
+            }
+		};
+
+		[TestMethod]
+		void ReverseUtf8CharactersKeepsMultiByteSequencesIntact() {
+            // a, U+00E9, U+4E2D, U+1F600, b reversed one code point at a time
+            char buffer[32]   = "a\xC3\xA9\xE4\xB8\xAD\xF0\x9F\x98\x80" "b";
+            char expected[32] = "b\xF0\x9F\x98\x80\xE4\xB8\xAD\xC3\xA9" "a";
+
+            reverse_utf8_characters_in_place(buffer, strlen(buffer));
+
+            Assert::AreEqual(0, strcmp(expected, buffer));
+		};
+
+		[TestMethod]
+		void ReverseWordsKeepsUtf8WordsIntact() {
+            char buffer[64]   = "caf\xC3\xA9 \xE4\xB8\xAD\xE6\x96\x87 na\xC3\xAFve";
+            char expected[64] = "na\xC3\xAFve \xE4\xB8\xAD\xE6\x96\x87 caf\xC3\xA9";
+
+            reverse_words(buffer);
+
+            Assert::AreEqual(0, strcmp(expected, buffer));
+		};
+
+		[TestMethod]
+		void ReverseWideCharactersKeepsSurrogatePairsIntact() {
+            const simd_level originalLevel = get_simd_level();
+            // A long enough string to be processed in blocks, with a surrogate pair straddling two of them.
+            wchar_t source[]   = L"abcdefg\xD83D\xDE00hijklmnop\xD834\xDD1Eq";
+            wchar_t expected[] = L"q\xD834\xDD1Eponmlkjih\xD83D\xDE00gfedcba";
+            wchar_t actual[sizeof(source) / sizeof(source[0])];
+
+            try {
+                for (int level = SIMD_NONE; level <= SIMD_SSSE3; level++) {
+                    set_simd_level((simd_level)level);
+                    memcpy(actual, source, sizeof(source));
+                    reverse_characters_in_place(actual, wcslen(actual));
+
+                    Assert::AreEqual(gcnew String(expected), gcnew String(actual));
+                }
+            } finally {
+                set_simd_level(originalLevel);
+            }
+		};
+
+		[TestMethod]
+		void ReverseWideWordsKeepsSurrogatePairsIntact() {
+			wchar_t buffer[32]   = L"one \xD83D\xDE00two three";
+            wchar_t expected[32] = L"three \xD83D\xDE00two one";
+
+            reverse_words(buffer);
+
+            Assert::AreEqual(gcnew String(expected), gcnew String(buffer));
+		};
+
         //
         // duplicate_list tests
         //
@@ -262,6 +501,23 @@ namespace Test
             delete board;
         }
 
+        [TestMethod]
+        void PrecomputesCellNeighbors() {
+            Boggle::Board * board = new Boggle::Board(4, 3);
+
+            // Corners, edges and the middle of the board.
+            Assert::AreEqual(3U, board->neighborCount(0));
+            Assert::AreEqual(5U, board->neighborCount(1));
+            Assert::AreEqual(8U, board->neighborCount(5));
+            Assert::AreEqual(3U, board->neighborCount(11));
+
+            const unsigned expected[] = { 1, 4, 5 };
+            for (unsigned i = 0; i < 3; i++)
+                Assert::AreEqual(expected[i], board->neighbors(0)[i]);
+
+            delete board;
+        }
+
         [TestMethod]
         void RejectsLopsidedBoard() {
             String ^ assemblyDir = Path::GetDirectoryName(GetAssemblyPath());
@@ -371,6 +627,539 @@ namespace Test
             std::set<std::string> result = board->findWords(dictionary);
             Assert::AreEqual(163U, result.size());
 
+            delete dictionary;
+            delete board;
+        }
+
+        [TestMethod]
+        void FindsWordIdsAcrossRepeatedSolves() {
+            String ^ assemblyDir = Path::GetDirectoryName(GetAssemblyPath());
+            String ^ normalBoardPath = Path::Combine(assemblyDir, gcnew String("..\\TestData\\normalboard.txt"));
+            String ^ hugeBoardPath = Path::Combine(assemblyDir, gcnew String("..\\TestData\\hugeuppercaseboard.txt"));
+            String ^ dictionaryPath = Path::Combine(assemblyDir, gcnew String("..\\TestData\\enable1.txt"));
+
+            const char * boardPathPtr = (const char *)(Marshal::StringToHGlobalAnsi(normalBoardPath)).ToPointer();
+            Boggle::Board * normalBoard = Boggle::Board::fromFile(boardPathPtr);
+            Marshal::FreeHGlobal(IntPtr((void*)boardPathPtr));
+
+            boardPathPtr = (const char *)(Marshal::StringToHGlobalAnsi(hugeBoardPath)).ToPointer();
+            Boggle::Board * hugeBoard = Boggle::Board::fromFile(boardPathPtr);
+            Marshal::FreeHGlobal(IntPtr((void*)boardPathPtr));
+
+            const char * dictionaryPathPtr = (const char *)(Marshal::StringToHGlobalAnsi(dictionaryPath)).ToPointer();
+            Boggle::Dictionary * dictionary = new Boggle::Dictionary(dictionaryPathPtr);
+            Marshal::FreeHGlobal(IntPtr((void*)dictionaryPathPtr));
+
+            // The same set is reused for every solve, so each one must start out empty.
+            Boggle::FoundWords found;
+            hugeBoard->findWords(dictionary, found);
+            Assert::AreEqual(163U, found.size());
+
+            normalBoard->findWords(dictionary, found);
+            Assert::AreEqual(87U, found.size());
+
+            std::set<std::string> expected = normalBoard->findWords(dictionary);
+            for (unsigned i = 0; i < found.ids.size(); i++) {
+                Assert::IsTrue(found.contains(found.ids[i]));
+                Assert::IsTrue(expected.count(dictionary->word(found.ids[i])) == 1);
+            }
+
+            delete dictionary;
+            delete hugeBoard;
+            delete normalBoard;
+        }
+
+        [TestMethod]
+        void StreamsWordsToSinkAndStopsEarly() {
+            String ^ assemblyDir = Path::GetDirectoryName(GetAssemblyPath());
+            String ^ boardPath = Path::Combine(assemblyDir, gcnew String("..\\TestData\\normalboard.txt"));
+            String ^ dictionaryPath = Path::Combine(assemblyDir, gcnew String("..\\TestData\\enable1.txt"));
+
+            const char * boardPathPtr = (const char *)(Marshal::StringToHGlobalAnsi(boardPath)).ToPointer();
+            Boggle::Board * board = Boggle::Board::fromFile(boardPathPtr);
+            Marshal::FreeHGlobal(IntPtr((void*)boardPathPtr));
+
+            const char * dictionaryPathPtr = (const char *)(Marshal::StringToHGlobalAnsi(dictionaryPath)).ToPointer();
+            Boggle::Dictionary * dictionary = new Boggle::Dictionary(dictionaryPathPtr);
+            Marshal::FreeHGlobal(IntPtr((void*)dictionaryPathPtr));
+
+            StoppingWordSink everything(board, 1000);
+            Assert::IsTrue(board->findWords(dictionary, everything));
+            Assert::AreEqual(87U, everything.ids.size());
+
+            // Every reported path must spell out the word it was reported with.
+            for (unsigned i = 0; i < everything.ids.size(); i++)
+                Assert::IsTrue(everything.spelledWords[i] == dictionary->word(everything.ids[i]));
+
+            StoppingWordSink firstFive(board, 5);
+            Boggle::FoundWords found;
+            Assert::IsFalse(board->findWords(dictionary, firstFive, found));
+            Assert::AreEqual(5U, firstFive.ids.size());
+            Assert::AreEqual(5U, found.size());
+
+            delete dictionary;
+            delete board;
+        }
+
+        [TestMethod]
+        void ScoresNormalBoardWithoutListingWords() {
+            String ^ assemblyDir = Path::GetDirectoryName(GetAssemblyPath());
+            String ^ boardPath = Path::Combine(assemblyDir, gcnew String("..\\TestData\\normalboard.txt"));
+            String ^ dictionaryPath = Path::Combine(assemblyDir, gcnew String("..\\TestData\\enable1.txt"));
+
+            const char * boardPathPtr = (const char *)(Marshal::StringToHGlobalAnsi(boardPath)).ToPointer();
+            Boggle::Board * board = Boggle::Board::fromFile(boardPathPtr);
+            Marshal::FreeHGlobal(IntPtr((void*)boardPathPtr));
+
+            const char * dictionaryPathPtr = (const char *)(Marshal::StringToHGlobalAnsi(dictionaryPath)).ToPointer();
+            Boggle::Dictionary * dictionary = new Boggle::Dictionary(dictionaryPathPtr);
+            Marshal::FreeHGlobal(IntPtr((void*)dictionaryPathPtr));
+
+            Assert::AreEqual(1U, Boggle::scoreWord(4));
+            Assert::AreEqual(2U, Boggle::scoreWord(5));
+            Assert::AreEqual(11U, Boggle::scoreWord(9));
+
+            Boggle::BoardScore score = board->scoreWords(dictionary);
+            Assert::AreEqual(87U, score.wordCount);
+            Assert::AreEqual(117U, score.score);
+
+            delete dictionary;
+            delete board;
+        }
+
+        [TestMethod]
+        void FixedSizeSolverMatchesGenericSolver() {
+            String ^ assemblyDir = Path::GetDirectoryName(GetAssemblyPath());
+            String ^ dictionaryPath = Path::Combine(assemblyDir, gcnew String("..\\TestData\\enable1.txt"));
+
+            const char * dictionaryPathPtr = (const char *)(Marshal::StringToHGlobalAnsi(dictionaryPath)).ToPointer();
+            Boggle::Dictionary * dictionary = new Boggle::Dictionary(dictionaryPathPtr);
+            Marshal::FreeHGlobal(IntPtr((void*)dictionaryPathPtr));
+
+            // The extra column of digits can't be part of any word, but it makes the second board 7x6,
+            //  which is solved by the generic search instead of the one specialized for 6x6 boards.
+            const char * square = "serats\nnoetil\nratsed\nolmnai\nedcops\ntinera";
+            const char * padded = "serats0\nnoetil0\nratsed0\nolmnai0\nedcops0\ntinera0";
+            Boggle::Board * squareBoard = Boggle::Board::fromString(square, strlen(square));
+            Boggle::Board * paddedBoard = Boggle::Board::fromString(padded, strlen(padded));
+
+            std::set<std::string> expected = paddedBoard->findWords(dictionary);
+            std::set<std::string> result = squareBoard->findWords(dictionary);
+            Assert::IsTrue(expected.size() > 0);
+            Assert::IsTrue(result == expected);
+
+            delete paddedBoard;
+            delete squareBoard;
+            delete dictionary;
+        }
+
+        [TestMethod]
+        void IncrementalSolverTracksCellChanges() {
+            String ^ assemblyDir = Path::GetDirectoryName(GetAssemblyPath());
+            String ^ boardPath = Path::Combine(assemblyDir, gcnew String("..\\TestData\\normalboard.txt"));
+            String ^ dictionaryPath = Path::Combine(assemblyDir, gcnew String("..\\TestData\\enable1.txt"));
+
+            const char * boardPathPtr = (const char *)(Marshal::StringToHGlobalAnsi(boardPath)).ToPointer();
+            Boggle::Board * board = Boggle::Board::fromFile(boardPathPtr);
+            Marshal::FreeHGlobal(IntPtr((void*)boardPathPtr));
+
+            const char * dictionaryPathPtr = (const char *)(Marshal::StringToHGlobalAnsi(dictionaryPath)).ToPointer();
+            Boggle::Dictionary * dictionary = new Boggle::Dictionary(dictionaryPathPtr);
+            Marshal::FreeHGlobal(IntPtr((void*)dictionaryPathPtr));
+
+            Boggle::IncrementalSolver solver(board, dictionary);
+            Assert::AreEqual(87U, solver.wordCount());
+
+            std::vector<Boggle::WordId> added, removed;
+            Boggle::FoundWords before, after;
+            const char * letters = "qzestrak";
+            char original = board->at(1, 2);
+
+            for (unsigned i = 0; letters[i]; i++) {
+                board->findWords(dictionary, before);
+                solver.setCell(1, 2, letters[i], added, removed);
+                board->findWords(dictionary, after);
+
+                // The solver has to agree with a full solve of the changed board.
+                Assert::AreEqual(after.size(), (size_t)solver.wordCount());
+                for (unsigned j = 0; j < after.ids.size(); j++)
+                    Assert::IsTrue(solver.contains(after.ids[j]));
+
+                for (unsigned j = 0; j < added.size(); j++)
+                    Assert::IsTrue(!before.contains(added[j]) && after.contains(added[j]));
+                for (unsigned j = 0; j < removed.size(); j++)
+                    Assert::IsTrue(before.contains(removed[j]) && !after.contains(removed[j]));
+            }
+
+            solver.setCell(1, 2, original, added, removed);
+            Assert::AreEqual(87U, solver.wordCount());
+
+            delete dictionary;
+            delete board;
+        }
+
+        // Not really a test: reports how long IncrementalSolver::setCell takes per change against changing
+        //  the same cells and solving the board from scratch with findWords.
+        [TestMethod]
+        void IncrementalSolverBenchmark() {
+            String ^ assemblyDir = Path::GetDirectoryName(GetAssemblyPath());
+            String ^ boardPath = Path::Combine(assemblyDir, gcnew String("..\\TestData\\largeboard.txt"));
+            String ^ dictionaryPath = Path::Combine(assemblyDir, gcnew String("..\\TestData\\enable1.txt"));
+
+            const char * boardPathPtr = (const char *)(Marshal::StringToHGlobalAnsi(boardPath)).ToPointer();
+            Boggle::Board * board = Boggle::Board::fromFile(boardPathPtr);
+            Marshal::FreeHGlobal(IntPtr((void*)boardPathPtr));
+
+            const char * dictionaryPathPtr = (const char *)(Marshal::StringToHGlobalAnsi(dictionaryPath)).ToPointer();
+            Boggle::Dictionary * dictionary = new Boggle::Dictionary(dictionaryPathPtr);
+            Marshal::FreeHGlobal(IntPtr((void*)dictionaryPathPtr));
+
+            Boggle::IncrementalSolver solver(board, dictionary);
+            std::vector<Boggle::WordId> added, removed;
+            Boggle::FoundWords found;
+            const char * letters = "etaoinsrhldcumpgbyfwkvxzjq";
+            const unsigned changes = 4000;
+
+            // Both loops make the same changes, so they leave the board in the same state.
+            unsigned seed = 12345;
+            Diagnostics::Stopwatch ^ stopwatch = Diagnostics::Stopwatch::StartNew();
+            for (unsigned i = 0; i < changes; i++) {
+                seed = (seed * 1103515245) + 12345;
+                unsigned r = seed >> 16;
+                solver.setCell(r % board->width, (r / 8) % board->height, letters[(r / 64) % 26], added, removed);
+            }
+            stopwatch->Stop();
+            double incrementalMicroseconds = (stopwatch->Elapsed.TotalMilliseconds * 1000.0) / changes;
+
+            seed = 12345;
+            stopwatch = Diagnostics::Stopwatch::StartNew();
+            for (unsigned i = 0; i < changes; i++) {
+                seed = (seed * 1103515245) + 12345;
+                unsigned r = seed >> 16;
+                board->at(r % board->width, (r / 8) % board->height) = letters[(r / 64) % 26];
+                board->findWords(dictionary, found);
+            }
+            stopwatch->Stop();
+            double fullMicroseconds = (stopwatch->Elapsed.TotalMilliseconds * 1000.0) / changes;
+
+            Assert::AreEqual(found.size(), (size_t)solver.wordCount());
+            TestContext->WriteLine("IncrementalSolver::setCell: {0:F1} us per change", incrementalMicroseconds);
+            TestContext->WriteLine("Board::findWords: {0:F1} us per change", fullMicroseconds);
+
+            delete dictionary;
+            delete board;
+        }
+
+        [TestMethod]
+        void SolveCacheSharesEntriesBetweenRotations() {
+            String ^ assemblyDir = Path::GetDirectoryName(GetAssemblyPath());
+            String ^ boardPath = Path::Combine(assemblyDir, gcnew String("..\\TestData\\normalboard.txt"));
+            String ^ dictionaryPath = Path::Combine(assemblyDir, gcnew String("..\\TestData\\enable1.txt"));
+
+            const char * boardPathPtr = (const char *)(Marshal::StringToHGlobalAnsi(boardPath)).ToPointer();
+            Boggle::Board * board = Boggle::Board::fromFile(boardPathPtr);
+            Marshal::FreeHGlobal(IntPtr((void*)boardPathPtr));
+
+            const char * dictionaryPathPtr = (const char *)(Marshal::StringToHGlobalAnsi(dictionaryPath)).ToPointer();
+            Boggle::Dictionary * dictionary = new Boggle::Dictionary(dictionaryPathPtr);
+            Marshal::FreeHGlobal(IntPtr((void*)dictionaryPathPtr));
+
+            // Rotate the board a quarter turn clockwise.
+            Boggle::Board * rotated = new Boggle::Board(board->height, board->width);
+            for (unsigned y = 0; y < board->height; y++) {
+                for (unsigned x = 0; x < board->width; x++)
+                    rotated->at(board->height - 1 - y, x) = board->at(x, y);
+            }
+
+            Assert::IsTrue(Boggle::SolveCache::canonicalKey(board) == Boggle::SolveCache::canonicalKey(rotated));
+
+            Boggle::SolveCache cache(dictionary, 1024 * 1024);
+            Boggle::FoundWords found;
+
+            cache.findWords(board, found);
+            Assert::AreEqual(87U, found.size());
+            cache.findWords(rotated, found);
+            Assert::AreEqual(87U, found.size());
+
+            Assert::AreEqual(1U, cache.misses);
+            Assert::AreEqual(1U, cache.hits);
+            Assert::AreEqual(1U, cache.size());
+
+            delete rotated;
+            delete dictionary;
+            delete board;
+        }
+
+        [TestMethod]
+        void InterleavedSolveMatchesFindWords() {
+            String ^ assemblyDir = Path::GetDirectoryName(GetAssemblyPath());
+            String ^ boardPath = Path::Combine(assemblyDir, gcnew String("..\\TestData\\hugeuppercaseboard.txt"));
+            String ^ dictionaryPath = Path::Combine(assemblyDir, gcnew String("..\\TestData\\enable1.txt"));
+
+            const char * boardPathPtr = (const char *)(Marshal::StringToHGlobalAnsi(boardPath)).ToPointer();
+            Boggle::Board * board = Boggle::Board::fromFile(boardPathPtr);
+            Marshal::FreeHGlobal(IntPtr((void*)boardPathPtr));
+
+            const char * dictionaryPathPtr = (const char *)(Marshal::StringToHGlobalAnsi(dictionaryPath)).ToPointer();
+            Boggle::Dictionary * dictionary = new Boggle::Dictionary(dictionaryPathPtr);
+            Marshal::FreeHGlobal(IntPtr((void*)dictionaryPathPtr));
+
+            Boggle::FoundWords expected, result;
+            board->findWords(dictionary, expected);
+
+            // More searches than there are cells is fine too.
+            const unsigned searchCounts[] = { 1, 3, 8, 64 };
+            for (unsigned i = 0; i < 4; i++) {
+                board->findWordsInterleaved(dictionary, result, searchCounts[i]);
+
+                Assert::AreEqual(163U, result.size());
+                for (unsigned j = 0; j < expected.ids.size(); j++)
+                    Assert::IsTrue(result.contains(expected.ids[j]));
+            }
+
+            delete dictionary;
+            delete board;
+        }
+
+        // Not really a test: reports how long findWords and findWordsInterleaved take on a 10x10 board
+        //  when none of the trie is cached, which is where the interleaved search is meant to help.
+        [TestMethod]
+        void InterleavedSolveColdCacheBenchmark() {
+            String ^ assemblyDir = Path::GetDirectoryName(GetAssemblyPath());
+            String ^ dictionaryPath = Path::Combine(assemblyDir, gcnew String("..\\TestData\\enable1.txt"));
+
+            const char * dictionaryPathPtr = (const char *)(Marshal::StringToHGlobalAnsi(dictionaryPath)).ToPointer();
+            Boggle::Dictionary * dictionary = new Boggle::Dictionary(dictionaryPathPtr);
+            Marshal::FreeHGlobal(IntPtr((void*)dictionaryPathPtr));
+
+            const unsigned size = 10;
+            const char * letters = "eeeettaaoiinnssrrhldcumpgbyfwkvxzjq";
+            std::string characters;
+            unsigned seed = 12345;
+
+            for (unsigned row = 0; row < size; row++) {
+                for (unsigned col = 0; col < size; col++) {
+                    seed = (seed * 1103515245) + 12345;
+                    characters += letters[(seed >> 16) % 35];
+                }
+                characters += '\n';
+            }
+
+            Boggle::Board * board = Boggle::Board::fromString(characters.c_str(), characters.size());
+            Boggle::FoundWords expected, result;
+
+            // Reading a buffer much larger than the cache before each solve pushes the trie out of it.
+            const size_t flushSize = 64 * 1024 * 1024;
+            std::vector<char> flush(flushSize);
+            const unsigned solves = 20;
+            double directMilliseconds = 0, interleavedMilliseconds = 0;
+
+            for (unsigned i = 0; i < solves; i++) {
+                for (size_t j = 0; j < flushSize; j += 64)
+                    flush[j]++;
+
+                Diagnostics::Stopwatch ^ stopwatch = Diagnostics::Stopwatch::StartNew();
+                board->findWords(dictionary, expected);
+                directMilliseconds += stopwatch->Elapsed.TotalMilliseconds;
+
+                for (size_t j = 0; j < flushSize; j += 64)
+                    flush[j]++;
+
+                stopwatch = Diagnostics::Stopwatch::StartNew();
+                board->findWordsInterleaved(dictionary, result);
+                interleavedMilliseconds += stopwatch->Elapsed.TotalMilliseconds;
+            }
+
+            Assert::AreEqual(expected.size(), result.size());
+            TestContext->WriteLine("findWords: {0:F0} us per solve", (directMilliseconds * 1000.0) / solves);
+            TestContext->WriteLine("findWordsInterleaved: {0:F0} us per solve", (interleavedMilliseconds * 1000.0) / solves);
+
+            delete board;
+            delete dictionary;
+        }
+
+        [TestMethod]
+        void RareLetterSolveMatchesFindWords() {
+            String ^ assemblyDir = Path::GetDirectoryName(GetAssemblyPath());
+            String ^ boardPath = Path::Combine(assemblyDir, gcnew String("..\\TestData\\largeboard.txt"));
+            String ^ dictionaryPath = Path::Combine(assemblyDir, gcnew String("..\\TestData\\enable1.txt"));
+
+            const char * boardPathPtr = (const char *)(Marshal::StringToHGlobalAnsi(boardPath)).ToPointer();
+            Boggle::Board * board = Boggle::Board::fromFile(boardPathPtr);
+            Marshal::FreeHGlobal(IntPtr((void*)boardPathPtr));
+
+            const char * dictionaryPathPtr = (const char *)(Marshal::StringToHGlobalAnsi(dictionaryPath)).ToPointer();
+            Boggle::Dictionary * dictionary = new Boggle::Dictionary(dictionaryPathPtr);
+            Marshal::FreeHGlobal(IntPtr((void*)dictionaryPathPtr));
+
+            Boggle::GaddagDictionary * gaddag = new Boggle::GaddagDictionary(dictionary);
+            Assert::IsTrue(gaddag->letterRank('q') < gaddag->letterRank('e'));
+
+            Boggle::FoundWords expected, result;
+            board->findWords(dictionary, expected);
+            board->findWords(gaddag, result);
+
+            Assert::AreEqual(382U, result.size());
+            for (unsigned i = 0; i < expected.ids.size(); i++)
+                Assert::IsTrue(result.contains(expected.ids[i]));
+
+            delete gaddag;
+            delete dictionary;
+            delete board;
+        }
+
+        [TestMethod]
+        void CountsSearchWork() {
+            String ^ assemblyDir = Path::GetDirectoryName(GetAssemblyPath());
+            String ^ boardPath = Path::Combine(assemblyDir, gcnew String("..\\TestData\\normalboard.txt"));
+            String ^ dictionaryPath = Path::Combine(assemblyDir, gcnew String("..\\TestData\\enable1.txt"));
+
+            const char * boardPathPtr = (const char *)(Marshal::StringToHGlobalAnsi(boardPath)).ToPointer();
+            Boggle::Board * board = Boggle::Board::fromFile(boardPathPtr);
+            Marshal::FreeHGlobal(IntPtr((void*)boardPathPtr));
+
+            const char * dictionaryPathPtr = (const char *)(Marshal::StringToHGlobalAnsi(dictionaryPath)).ToPointer();
+            Boggle::Dictionary * dictionary = new Boggle::Dictionary(dictionaryPathPtr);
+            Marshal::FreeHGlobal(IntPtr((void*)dictionaryPathPtr));
+
+            Boggle::FoundWords result;
+            Boggle::SolveStats stats;
+            board->findWords(dictionary, result, stats);
+
+            Assert::AreEqual(87U, result.size());
+            Assert::AreEqual(456ULL, stats.nodesVisited);
+            Assert::AreEqual(1481ULL, stats.deadEnds);
+            Assert::AreEqual(732ULL, stats.revisitsRejected);
+
+            // Every cell starts a one letter prefix, and every node visited
+            //  is counted at exactly one depth.
+            Assert::AreEqual(16U, stats.depthCounts.size());
+            Assert::AreEqual(16ULL, stats.depthCounts[0]);
+            unsigned __int64 total = 0;
+            for (unsigned i = 0; i < stats.depthCounts.size(); i++)
+                total += stats.depthCounts[i];
+            Assert::AreEqual(stats.nodesVisited, total);
+
+            Assert::AreEqual(16U, stats.startCellSeconds.size());
+            for (unsigned i = 0; i < stats.startCellSeconds.size(); i++)
+                Assert::IsTrue(stats.startCellSeconds[i] >= 0);
+
+            delete dictionary;
+            delete board;
+        }
+
+        [TestMethod]
+        void StopsWhenBudgetRunsOut() {
+            String ^ assemblyDir = Path::GetDirectoryName(GetAssemblyPath());
+            String ^ boardPath = Path::Combine(assemblyDir, gcnew String("..\\TestData\\normalboard.txt"));
+            String ^ dictionaryPath = Path::Combine(assemblyDir, gcnew String("..\\TestData\\enable1.txt"));
+
+            const char * boardPathPtr = (const char *)(Marshal::StringToHGlobalAnsi(boardPath)).ToPointer();
+            Boggle::Board * board = Boggle::Board::fromFile(boardPathPtr);
+            Marshal::FreeHGlobal(IntPtr((void*)boardPathPtr));
+
+            const char * dictionaryPathPtr = (const char *)(Marshal::StringToHGlobalAnsi(dictionaryPath)).ToPointer();
+            Boggle::Dictionary * dictionary = new Boggle::Dictionary(dictionaryPathPtr);
+            Marshal::FreeHGlobal(IntPtr((void*)dictionaryPathPtr));
+
+            Boggle::FoundWords expected, result;
+            board->findWords(dictionary, expected);
+
+            Assert::IsTrue(board->findWords(dictionary, result, Boggle::SolveBudget()));
+            Assert::AreEqual(87U, result.size());
+
+            Assert::IsTrue(board->findWords(dictionary, result, Boggle::SolveBudget(0, 60.0)));
+            Assert::AreEqual(87U, result.size());
+
+            // The whole search visits 456 nodes, so that is just enough.
+            Assert::IsTrue(board->findWords(dictionary, result, Boggle::SolveBudget(456)));
+            Assert::AreEqual(87U, result.size());
+
+            Assert::IsFalse(board->findWords(dictionary, result, Boggle::SolveBudget(455)));
+
+            Assert::IsFalse(board->findWords(dictionary, result, Boggle::SolveBudget(100)));
+            Assert::IsTrue(result.size() > 0);
+            Assert::IsTrue(result.size() < 87);
+            for (unsigned i = 0; i < result.ids.size(); i++)
+                Assert::IsTrue(expected.contains(result.ids[i]));
+
+            delete dictionary;
+            delete board;
+        }
+
+        [TestMethod]
+        void OptimizesBoardsReproducibly() {
+            String ^ assemblyDir = Path::GetDirectoryName(GetAssemblyPath());
+            String ^ dictionaryPath = Path::Combine(assemblyDir, gcnew String("..\\TestData\\enable1.txt"));
+
+            const char * dictionaryPathPtr = (const char *)(Marshal::StringToHGlobalAnsi(dictionaryPath)).ToPointer();
+            Boggle::Dictionary * dictionary = new Boggle::Dictionary(dictionaryPathPtr);
+            Marshal::FreeHGlobal(IntPtr((void*)dictionaryPathPtr));
+
+            Boggle::OptimizerSettings settings(4, 4);
+            settings.chainCount = 4;
+            settings.iterations = 200;
+            settings.seed = 12;
+
+            std::vector<Boggle::ScoredBoard> first = Boggle::optimizeBoards(dictionary, settings);
+            std::vector<Boggle::ScoredBoard> second = Boggle::optimizeBoards(dictionary, settings);
+
+            Assert::AreEqual(4U, first.size());
+            Assert::AreEqual(4U, second.size());
+
+            for (unsigned i = 0; i < first.size(); i++) {
+                Assert::IsTrue(first[i].characters == second[i].characters);
+                Assert::AreEqual(first[i].seed, second[i].seed);
+                Assert::IsTrue((first[i].seed >= 12) && (first[i].seed < 16));
+
+                if (i > 0)
+                    Assert::IsTrue(first[i - 1].score.score >= first[i].score.score);
+
+                // The reported score has to match a fresh solve of the board.
+                Boggle::Board * board = Boggle::Board::fromString(first[i].characters.c_str(), first[i].characters.size());
+                Assert::AreEqual(first[i].score.score, board->scoreWords(dictionary).score);
+                Assert::AreEqual(first[i].score.wordCount, board->scoreWords(dictionary).wordCount);
+                delete board;
+            }
+
+            delete dictionary;
+        }
+
+        [TestMethod]
+        void SharesOneTrieBetweenWordLists() {
+            String ^ assemblyDir = Path::GetDirectoryName(GetAssemblyPath());
+            String ^ boardPath = Path::Combine(assemblyDir, gcnew String("..\\TestData\\normalboard.txt"));
+            String ^ dictionaryPath = Path::Combine(assemblyDir, gcnew String("..\\TestData\\enable1.txt"));
+            String ^ kidsDictionaryPath = Path::Combine(assemblyDir, gcnew String("..\\TestData\\kidswords.txt"));
+
+            const char * boardPathPtr = (const char *)(Marshal::StringToHGlobalAnsi(boardPath)).ToPointer();
+            Boggle::Board * board = Boggle::Board::fromFile(boardPathPtr);
+            Marshal::FreeHGlobal(IntPtr((void*)boardPathPtr));
+
+            const char * dictionaryPaths[2];
+            dictionaryPaths[0] = (const char *)(Marshal::StringToHGlobalAnsi(dictionaryPath)).ToPointer();
+            dictionaryPaths[1] = (const char *)(Marshal::StringToHGlobalAnsi(kidsDictionaryPath)).ToPointer();
+            Boggle::Dictionary * dictionary = new Boggle::Dictionary(dictionaryPaths, 2);
+            Marshal::FreeHGlobal(IntPtr((void*)dictionaryPaths[0]));
+            Marshal::FreeHGlobal(IntPtr((void*)dictionaryPaths[1]));
+
+            // Only "faye" isn't already in enable1.
+            Assert::AreEqual(172821U, dictionary->wordCount);
+            Assert::AreEqual(2U, dictionary->listCount);
+
+            Boggle::FoundWords result;
+
+            board->findWords(dictionary, 1, result);
+            Assert::AreEqual(87U, result.size());
+
+            board->findWords(dictionary, 2, result);
+            Assert::AreEqual(7U, result.size());
+            for (unsigned i = 0; i < result.ids.size(); i++)
+                Assert::IsTrue((dictionary->wordLists(result.ids[i]) & 2) != 0);
+
+            board->findWords(dictionary, Boggle::ALL_WORD_LISTS, result);
+            Assert::AreEqual(88U, result.size());
+
             delete dictionary;
             delete board;
         }    
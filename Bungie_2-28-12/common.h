@@ -4,10 +4,38 @@
 #include <vector>
 #include <string>
 #include <set>
+#include <list>
+#include <unordered_map>
+#include <stdio.h>
 
 void reverse_words (char *);
 void reverse_characters_in_place (char *, size_t);
 
+// Reverses the characters of a UTF-8 string, treating each multi-byte sequence as a single character.
+void reverse_utf8_characters_in_place (char *, size_t);
+
+// UTF-16 versions. Surrogate pairs are treated as single characters.
+void reverse_words (wchar_t *);
+void reverse_characters_in_place (wchar_t *, size_t);
+
+// Instruction sets that reverse_words and reverse_characters_in_place know how to use. The best level
+//  supported by the CPU is selected automatically the first time either function is called.
+enum simd_level {
+    SIMD_NONE  = 0,
+    SIMD_SSE2  = 1,
+    SIMD_SSSE3 = 2
+};
+
+simd_level detect_simd_level ();
+simd_level get_simd_level ();
+// Overrides the automatically selected level. Requests for a level the CPU does not support are
+//  clamped to the best supported one. Mostly useful for testing and benchmarking the fallback paths.
+void set_simd_level (simd_level);
+
+// Reverses the order of words read from a seekable input stream and writes them to output, holding at most
+//  two blocks of blockSize bytes in memory at a time.
+void reverse_words_in_stream (FILE * input, FILE * output, size_t blockSize = 1024 * 1024);
+
 struct s_node {
 	struct s_node * next;
 	struct s_node * reference;
@@ -27,14 +55,30 @@ namespace Boggle {
     struct CellId;
 
     typedef unsigned int NodeIndex;
+    // Words are numbered densely in the order they are added to a dictionary.
+    typedef unsigned int WordId;
+
+    // The word id of a node that does not terminate a word.
+    const WordId NO_WORD = 0xFFFFFFFF;
+
+    // The most word lists one dictionary can hold: one per bit of an unsigned int.
+    const unsigned MAXIMUM_WORD_LISTS = 32;
+    // A mask that selects the words of every list.
+    const unsigned ALL_WORD_LISTS = 0xFFFFFFFF;
 
     class Node {
     public:
         const char character;
-        const bool isValidWord;
+        WordId wordId;
+        // A bit for each letter that has a child node (bit 0 is 'a').
+        unsigned childLetters;
         NodeIndex children[26];
 
-        Node (char character, bool validWord);
+        Node (char character);
+
+        inline bool isValidWord () const {
+            return wordId != NO_WORD;
+        }
 
         inline bool contains (char ch) const {
             int index = ch - 'a';
@@ -48,26 +92,232 @@ namespace Boggle {
     class Dictionary {
     private:
         std::vector<Node> nodes;
+        // The text of every word, null terminated and packed end to end. wordOffsets[id] is the
+        //  position of word id within the pool.
+        std::vector<char> wordPool;
+        std::vector<unsigned> wordOffsets;
+        // A bit for each list that contains the word, indexed by word id (bit 0 is list 0).
+        std::vector<unsigned> wordListMasks;
 
-        NodeIndex allocateNode (char character, bool isValidWord);
+        NodeIndex allocateNode (char character);
+        void addWordsFromFile (const char * dictionaryPath, unsigned list);
 
     public:
+        // The number of unique words across all of the lists.
         unsigned wordCount;
+        unsigned listCount;
 
+        // Loads a single word list, which becomes list 0.
         Dictionary (const char * dictionaryPath);
+        // Loads several word lists into one trie, with dictionaryPaths[i] becoming list i. A word that is
+        //  in more than one list is stored once, and has a single id.
+        Dictionary (const char * const dictionaryPaths[], unsigned listCount);
 
-        NodeIndex addWord (const char * word, size_t wordLength);
+        NodeIndex addWord (const char * word, size_t wordLength, unsigned list = 0);
         inline const Node& node (NodeIndex index) const {
             if (index >= nodes.size())
                 throw std::exception("Node index out of range");
             
             return nodes[index];
         }
+
+        inline const char * word (WordId id) const {
+            if (id >= wordOffsets.size())
+                throw std::exception("Word id out of range");
+
+            return &wordPool[wordOffsets[id]];
+        }
+
+        inline unsigned wordLength (WordId id) const {
+            if (id >= wordOffsets.size())
+                throw std::exception("Word id out of range");
+
+            unsigned end = (id + 1 < wordOffsets.size()) ? wordOffsets[id + 1] : wordPool.size();
+            // Don't count the null terminator.
+            return end - wordOffsets[id] - 1;
+        }
+
+        // Returns a mask with a bit set for each list that contains the word.
+        inline unsigned wordLists (WordId id) const {
+            if (id >= wordListMasks.size())
+                throw std::exception("Word id out of range");
+
+            return wordListMasks[id];
+        }
+    };
+
+    // The words of a dictionary indexed by their rarest letter, for searching a board outward from the
+    //  letters that start the fewest words. Each word is split at the first occurrence of its rarest
+    //  letter (rarity is how often a letter appears in the dictionary) and stored as the letters from
+    //  there back to the start of the word, a separator, and then the rest of the word. A search that
+    //  starts from a common letter only has to consider words made up entirely of letters that are at
+    //  least as common.
+    // This is a GADDAG with a single split per word, so it takes about as much memory as the dictionary
+    //  itself instead of holding a copy of each word for every letter in it.
+    class GaddagDictionary {
+    private:
+        std::vector<Node> nodes;
+        // The node that follows the separator after node i is separators[i], or 0 if there isn't one.
+        std::vector<NodeIndex> separators;
+        // Each letter's position when the letters are sorted from rarest to most common.
+        unsigned char letterRanks[26];
+
+        NodeIndex allocateNode (char character);
+        NodeIndex addChild (NodeIndex parentIndex, char ch);
+
+    public:
+        // Words have the same ids here as in the dictionary this one was built from.
+        const Dictionary * const dictionary;
+
+        // The source dictionary must outlive this one.
+        GaddagDictionary (const Dictionary * dictionary);
+
+        inline const Node& node (NodeIndex index) const {
+            if (index >= nodes.size())
+                throw std::exception("Node index out of range");
+
+            return nodes[index];
+        }
+
+        inline NodeIndex separator (NodeIndex index) const {
+            if (index >= separators.size())
+                throw std::exception("Node index out of range");
+
+            return separators[index];
+        }
+
+        inline unsigned letterRank (char ch) const {
+            int index = ch - 'a';
+            if ((index < 0) || (index >= 26))
+                throw std::exception("Found a character outside of the range a-z");
+
+            return letterRanks[index];
+        }
+
+        inline size_t nodeCount () const {
+            return nodes.size();
+        }
+    };
+
+    // The words found by a solve, as ids in the order they were discovered.
+    // Each word carries the generation of the last solve that found it, so insert is an O(1) duplicate
+    //  check and starting a new solve doesn't have to clear anything. Reuse one across solves to avoid
+    //  reallocating.
+    class FoundWords {
+    private:
+        std::vector<unsigned> stamps;
+        unsigned generation;
+
+    public:
+        std::vector<WordId> ids;
+
+        FoundWords ();
+
+        // Empties the set and makes room for ids from a dictionary with wordCount words.
+        void clear (unsigned wordCount);
+
+        // Returns false if the word had already been found.
+        inline bool insert (WordId id) {
+            if (stamps[id] == generation)
+                return false;
+
+            stamps[id] = generation;
+            ids.push_back(id);
+            return true;
+        }
+
+        inline bool contains (WordId id) const {
+            return (id < stamps.size()) && (stamps[id] == generation);
+        }
+
+        inline size_t size () const {
+            return ids.size();
+        }
+    };
+
+    // Receives words as a solve discovers them. Each unique word is reported once, along with the
+    //  cells that spell it out (path[0] is the first letter). Return false to stop the solve early.
+    class WordSink {
+    public:
+        virtual ~WordSink () {
+        }
+
+        virtual bool wordFound (WordId id, const CellId * path, size_t length) = 0;
     };
 
+    // Adapts any function or functor with a WordSink::wordFound signature (a lambda, for example) into
+    //  a WordSink. Use makeWordSink to construct one.
+    template <typename TCallback>
+    class CallbackWordSink : public WordSink {
+    private:
+        TCallback callback;
+
+    public:
+        CallbackWordSink (TCallback _callback)
+            : callback(_callback) {
+        }
+
+        virtual bool wordFound (WordId id, const CellId * path, size_t length) {
+            return callback(id, path, length);
+        }
+    };
+
+    template <typename TCallback>
+    inline CallbackWordSink<TCallback> makeWordSink (TCallback callback) {
+        return CallbackWordSink<TCallback>(callback);
+    }
+
+    // Number of points a word of the given length is worth under standard Boggle rules.
+    unsigned scoreWord (unsigned wordLength);
+
+    struct BoardScore {
+        unsigned wordCount;
+        unsigned score;
+    };
+
+    // Counts of the work a solve did, for working out why some boards take so much longer than others.
+    // Only the findWords overload that takes a SolveStats collects them. Every other solve uses a
+    //  version of the search with the counting compiled out.
+    struct SolveStats {
+        // Trie nodes entered, which is one for every prefix the search followed.
+        unsigned __int64 nodesVisited;
+        // Steps onto a cell whose letter couldn't extend the prefix spelled so far.
+        unsigned __int64 deadEnds;
+        // Neighbors that were skipped because they were already on the path.
+        unsigned __int64 revisitsRejected;
+        // nodesVisited broken down by the length of the prefix: depthCounts[i] counts prefixes of i + 1
+        //  letters.
+        std::vector<unsigned __int64> depthCounts;
+        // The time spent on the paths that start from each cell, in seconds.
+        std::vector<double> startCellSeconds;
+
+        SolveStats ();
+
+        // Zeroes every counter, sized for a board with cellCount cells.
+        void clear (unsigned cellCount);
+    };
+
+    // Limits on how much work a solve may do before it gives up and returns the words found so far.
+    // A limit of zero means no limit.
+    struct SolveBudget {
+        // The most trie nodes the search may visit.
+        unsigned __int64 maximumNodes;
+        // How long the search may run for, in seconds.
+        double maximumSeconds;
+
+        explicit SolveBudget (unsigned __int64 maximumNodes = 0, double maximumSeconds = 0);
+    };
+
+    // A cell touches at most eight others: its orthogonal and diagonal neighbors.
+    const unsigned MAXIMUM_NEIGHBORS = 8;
+
     class Board {
     private:
         char * characters;
+        // Cells are numbered (row * width) + col. The neighbors of cell i are stored in
+        //  neighborCells[i * MAXIMUM_NEIGHBORS] onward, and there are neighborCounts[i] of them.
+        std::vector<unsigned> neighborCells;
+        std::vector<unsigned char> neighborCounts;
 
     public:
         const unsigned width, height;
@@ -83,7 +333,190 @@ namespace Boggle {
         char& at (unsigned col, unsigned row);
         char  at (unsigned col, unsigned row) const;
 
+        // Unchecked access by cell number, for use by the solver's inner loop.
+        inline char cellAt (unsigned cell) const {
+            return characters[cell];
+        }
+
+        inline unsigned neighborCount (unsigned cell) const {
+            return neighborCounts[cell];
+        }
+
+        inline const unsigned * neighbors (unsigned cell) const {
+            return &neighborCells[cell * MAXIMUM_NEIGHBORS];
+        }
+
+        // Replaces the contents of result with the words on the board.
+        void findWords (const Dictionary * dictionary, FoundWords & result) const;
         std::set<std::string> findWords (const Dictionary * dictionary) const;
+        // Same as findWords, but only counts words from the dictionary's lists that have a bit set in
+        //  lists. The whole search is a single walk of the shared trie whichever lists are chosen. The
+        //  other solves always count the words of every list.
+        void findWords (const Dictionary * dictionary, unsigned lists, FoundWords & result) const;
+        // Reports each unique word to sink as soon as it is found, and records it in found. Returns false
+        //  if the sink stopped the solve early, in which case found holds the words reported so far.
+        bool findWords (const Dictionary * dictionary, WordSink & sink, FoundWords & found) const;
+        bool findWords (const Dictionary * dictionary, WordSink & sink) const;
+        // Same as findWords, but also counts the work done by the search in stats.
+        void findWords (const Dictionary * dictionary, FoundWords & result, SolveStats & stats) const;
+        // Same as findWords, but gives up once the budget runs out. The cells that look cheapest to search
+        //  go first, so that a partial result holds as many words as possible. Returns false if the budget
+        //  ran out, in which case result only holds the words found so far.
+        bool findWords (const Dictionary * dictionary, FoundWords & result, const SolveBudget & budget) const;
+        // Finds the same words as findWords, but grows each word outward in both directions from its
+        //  rarest letter, so that cells holding common letters start very few paths.
+        void findWords (const GaddagDictionary * dictionary, FoundWords & result) const;
+
+        // Counts and scores the unique words on the board without building any strings. found is used as
+        //  scratch space, and afterwards holds the words that were counted.
+        BoardScore scoreWords (const Dictionary * dictionary, FoundWords & found) const;
+        BoardScore scoreWords (const Dictionary * dictionary) const;
+
+        // Same as findWords, but runs searchCount searches side by side, switching between them every time
+        //  one has to wait for a trie node to be fetched from memory. Each search prefetches the node it
+        //  needs next before yielding, so the fetches overlap instead of stalling one after another.
+        // This only pays off when the trie nodes aren't already cached: with the cache flushed before each
+        //  solve, eight searches took 124us against 173us for findWords on a 5x5 board and 679us against
+        //  1112us on a 10x10 board. When the same small board is solved over and over, findWords is faster.
+        void findWordsInterleaved (const Dictionary * dictionary, FoundWords & result, unsigned searchCount = 8) const;
+    };
+
+    // How optimizeBoards searches for high scoring boards.
+    struct OptimizerSettings {
+        unsigned width, height;
+        // The number of independent chains to run. They are spread across every available core.
+        unsigned chainCount;
+        // The number of letter changes each chain tries.
+        unsigned iterations;
+        // How many points worse a change can make the board and still have a fair chance of being
+        //  kept at the start of a chain. The temperature falls to zero by the end.
+        double initialTemperature;
+        // Chain i uses seed + i, so the same settings always find the same boards however the chains
+        //  happen to be scheduled, and whichever standard library the optimizer was built with.
+        unsigned seed;
+
+        OptimizerSettings (unsigned width, unsigned height);
+    };
+
+    struct ScoredBoard {
+        // The rows of the board, each followed by a newline, as read by Board::fromString.
+        std::string characters;
+        BoardScore score;
+        // The seed of the chain that found the board.
+        unsigned seed;
+    };
+
+    // Searches for boards that score as many points as possible, by simulated annealing over letter
+    //  changes and swaps. Returns the best board each chain found, highest scoring first.
+    std::vector<ScoredBoard> optimizeBoards (const Dictionary * dictionary, const OptimizerSettings & settings);
+
+    // Identifies a path remembered by an IncrementalSolver.
+    typedef unsigned int PathIndex;
+
+    // Marks a path with no parent, sibling or child.
+    const PathIndex NO_PATH = 0xFFFFFFFF;
+
+    // A path through the board that spells out a prefix of at least one word, as found by a search.
+    struct PrefixPath {
+        // The cells on the path, as bits numbered (row * width) + col.
+        unsigned __int64 cells;
+        NodeIndex node;
+        // The word the path spells, or NO_WORD if it doesn't spell a whole word.
+        WordId wordId;
+        // The letters that can follow the prefix, as bits (bit 0 is 'a').
+        unsigned nextLetters;
+        // The path this one extends by one cell, or NO_PATH if it starts here.
+        PathIndex parent;
+        // The paths that extend this one by one cell, as a list threaded through their sibling links.
+        PathIndex firstChild, nextSibling, previousSibling;
+        // Where the path is in its solver's list of paths ending at lastCell.
+        unsigned endingSlot;
+        unsigned char lastCell;
+        // Zero for a slot that doesn't hold a path.
+        unsigned char length;
+    };
+
+    // Keeps the words on a board up to date as its cells change, without solving the whole board again.
+    // The solver remembers every path its search followed as a tree, each path under the one it extends,
+    //  and lists the paths ending at each cell. Every path through a changed cell extends one of the paths
+    //  ending there, so a change only touches the paths through the cell and the paths ending next to it,
+    //  which it extends. Boards can have at most 64 cells.
+    class IncrementalSolver {
+    private:
+        Board * board;
+        const Dictionary * dictionary;
+        std::vector<PrefixPath> prefixes;
+        // Slots in prefixes left empty by removed paths, reused before the vector grows.
+        std::vector<PathIndex> freePaths;
+        // The paths whose last cell is each cell.
+        std::vector<std::vector<PathIndex> > pathsEndingAt;
+        // The number of remembered paths that spell each word.
+        std::vector<unsigned> pathCounts;
+        unsigned uniqueWordCount;
+        // Kept between calls to setCell so that they don't allocate every time.
+        std::vector<PathIndex> removalRoots, removalStack;
+
+        void removePaths (PathIndex root, std::vector<WordId> & disappeared);
+
+    public:
+        // Solves the board. The board must outlive the solver and should only be changed through setCell.
+        IncrementalSolver (Board * board, const Dictionary * dictionary);
+
+        // Changes the letter in a cell and updates the found words. The ids of words that are no longer on
+        //  the board are stored in removed, and the ids of newly formed words in added.
+        void setCell (
+            unsigned col, unsigned row, char ch, 
+            std::vector<WordId> & added, std::vector<WordId> & removed
+        );
+
+        inline bool contains (WordId id) const {
+            return (id < pathCounts.size()) && (pathCounts[id] > 0);
+        }
+
+        inline unsigned wordCount () const {
+            return uniqueWordCount;
+        }
+
+        // Replaces the contents of result with the words currently on the board.
+        void findWords (FoundWords & result) const;
+    };
+
+    // Remembers the words found on recently solved boards. Rotating or mirroring a board doesn't change
+    //  which words it contains, so all eight orientations of a board share one entry: boards are looked
+    //  up by whichever orientation sorts first. Once the entries use more than memoryLimit bytes (roughly),
+    //  the least recently used ones are discarded.
+    class SolveCache {
+    private:
+        struct Entry {
+            std::vector<WordId> words;
+            std::list<std::string>::iterator recency;
+        };
+
+        const Dictionary * dictionary;
+        std::unordered_map<std::string, Entry> entries;
+        // Keys of the entries, most recently used first.
+        std::list<std::string> recency;
+        size_t memoryLimit, memoryUsed;
+
+        static size_t entrySize (const std::string & key, const Entry & entry);
+
+    public:
+        unsigned hits, misses;
+
+        SolveCache (const Dictionary * dictionary, size_t memoryLimit);
+
+        // Replaces the contents of result with the words on the board, solving it only if neither it nor
+        //  any rotation or reflection of it is in the cache.
+        void findWords (const Board * board, FoundWords & result);
+
+        void clear ();
+
+        inline size_t size () const {
+            return entries.size();
+        }
+
+        // Returns a key that is identical for a board and all of its rotations and reflections.
+        static std::string canonicalKey (const Board * board);
     };
 
     struct CellId {
@@ -47,6 +47,195 @@ if (isNegative)
 else
   return result;
 
+//
+// Convert a string into a 64-bit signed integer quickly, eight digits at a time, detecting overflow
+//  and reporting where the number ended. Also parse a whole buffer of delimited integers at once.
+//
+
+#include <stdint.h>
+#include <string.h>
+#include <intrin.h>
+
+enum ParseResult {
+  PARSE_OK,
+  // There were no digits where a number was expected.
+  PARSE_NO_DIGITS,
+  // The number doesn't fit in 64 bits. The value is clamped to INT64_MIN/INT64_MAX.
+  PARSE_OVERFLOW,
+  // A number was followed by something other than the delimiter.
+  PARSE_BAD_DELIMITER
+};
+
+static const uint32_t POWERS_OF_TEN[] = {
+  1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000
+};
+
+// Returns a mask with the high bit set in every byte of chunk that isn't an ASCII digit. A byte below
+//  '0' wraps around when we subtract '0' and a byte above '9' overflows into the high bit when we
+//  add 0x46. Borrows and carries only ever travel towards more significant bytes, so the first
+//  flagged byte (which is the only one we care about) is always accurate.
+static inline uint64_t NonDigitMask (uint64_t chunk) {
+  return ((chunk - 0x3030303030303030ULL) | (chunk + 0x4646464646464646ULL)) & 0x8080808080808080ULL;
+}
+
+// Returns the index of the first byte flagged in a non-zero mask. _BitScanForward64 isn't
+//  available when targeting Win32, so we scan the two halves separately.
+static inline unsigned FirstFlaggedByte (uint64_t mask) {
+  unsigned long bit;
+  if (_BitScanForward(&bit, (unsigned long)mask))
+    return bit / 8;
+
+  _BitScanForward(&bit, (unsigned long)(mask >> 32));
+  return 4 + (bit / 8);
+}
+
+// Converts eight ASCII digits (the first digit in the least significant byte, as loaded from memory
+//  on x86) into their value with three multiplies instead of eight. Adjacent digits are combined
+//  into two-digit values, then pairs of those into four-digit values, then the two halves.
+static inline uint32_t ParseEightDigits (uint64_t chunk) {
+  chunk -= 0x3030303030303030ULL;
+  chunk = (chunk * 10) + (chunk >> 8);
+  chunk = (
+    ((chunk & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32))) +
+    (((chunk >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))
+  ) >> 32;
+  return (uint32_t)chunk;
+}
+
+// Parses an optionally signed decimal integer starting at begin and not extending past end.
+// stop is set to the first character after the number (after all of its digits, even if it
+//  overflowed). Unlike the loop above, parsing stops at the first character that isn't a digit.
+ParseResult ParseInt64 (const char * begin, const char * end, int64_t & value, const char * & stop) {
+  const char * p = begin;
+  bool isNegative = false;
+
+  if ((p < end) && ((*p == '-') || (*p == '+'))) {
+    isNegative = (*p == '-');
+    p++;
+  }
+
+  const char * const digitsStart = p;
+  // The magnitude of INT64_MIN is one larger than INT64_MAX.
+  const uint64_t limit = isNegative ? (uint64_t)INT64_MAX + 1 : (uint64_t)INT64_MAX;
+  uint64_t magnitude = 0;
+  bool overflowed = false;
+
+  // Handle up to eight digits per step. As long as the value so far is below 10^11, appending eight
+  //  more digits can't overflow 64 bits, so we only check against the limit once we are done. A
+  //  chunk that contains the end of the number is shifted so that its digits line up with the end of
+  //  the chunk and the bytes in front of them are filled in with '0's.
+  while (((end - p) >= 8) && (magnitude < 100000000000ULL)) {
+    uint64_t chunk;
+    memcpy(&chunk, p, sizeof(chunk));
+
+    const uint64_t nonDigits = NonDigitMask(chunk);
+    const unsigned count = nonDigits ? FirstFlaggedByte(nonDigits) : 8;
+    if (count == 0)
+      break;
+
+    if (count < 8)
+      chunk = (chunk << (8 * (8 - count))) | (0x3030303030303030ULL >> (8 * count));
+
+    magnitude = (magnitude * POWERS_OF_TEN[count]) + ParseEightDigits(chunk);
+    p += count;
+
+    if (count < 8)
+      break;
+  }
+
+  if (magnitude > limit)
+    overflowed = true;
+
+  // Near the end of the buffer, and for numbers too long to be handled safely above, fall back
+  //  to one digit at a time with an overflow check on each.
+  while (p < end) {
+    const unsigned placeValue = (unsigned)(*p - '0');
+    if (placeValue > 9)
+      break;
+
+    if (!overflowed) {
+      if (magnitude > (limit - placeValue) / 10)
+        overflowed = true;
+      else
+        magnitude = (magnitude * 10) + placeValue;
+    }
+
+    p++;
+  }
+
+  if (p == digitsStart) {
+    stop = begin;
+    value = 0;
+    return PARSE_NO_DIGITS;
+  }
+
+  stop = p;
+
+  if (overflowed) {
+    value = isNegative ? INT64_MIN : INT64_MAX;
+    return PARSE_OVERFLOW;
+  }
+
+  // Negate as unsigned so that INT64_MIN doesn't overflow.
+  value = (int64_t)(isNegative ? (0 - magnitude) : magnitude);
+  return PARSE_OK;
+}
+
+static inline bool IsWhitespace (char ch) {
+  return (ch == ' ') || (ch == '\t') || (ch == '\r') || (ch == '\n');
+}
+
+// Parses a buffer of integers separated by delimiter (whitespace around each number is ignored) into
+//  values, stopping after capacity numbers, at the end of the buffer or at the first error. Returns
+//  the number of values stored and sets stop to where parsing stopped and result to PARSE_OK or the
+//  error that stopped it. If the delimiter is a whitespace character, any run of whitespace
+//  separates two numbers.
+size_t ParseInt64List (
+  const char * begin, const char * end, char delimiter,
+  int64_t * values, size_t capacity, const char * & stop, ParseResult & result
+) {
+  const bool whitespaceDelimited = IsWhitespace(delimiter);
+  const char * p = begin;
+  size_t count = 0;
+  result = PARSE_OK;
+
+  while (count < capacity) {
+    // When the delimiter is whitespace this also consumes the separator after the previous number.
+    while ((p < end) && IsWhitespace(*p))
+      p++;
+
+    if (p >= end)
+      break;
+
+    result = ParseInt64(p, end, values[count], p);
+    if (result != PARSE_OK)
+      break;
+
+    count++;
+
+    if (whitespaceDelimited) {
+      if ((p < end) && !IsWhitespace(*p)) {
+        result = PARSE_BAD_DELIMITER;
+        break;
+      }
+      continue;
+    }
+
+    while ((p < end) && IsWhitespace(*p))
+      p++;
+
+    if ((p < end) && (*p == delimiter))
+      p++;
+    else if (p < end) {
+      result = PARSE_BAD_DELIMITER;
+      break;
+    }
+  }
+
+  stop = p;
+  return count;
+}
+
 //
 // Multiply an integer by 500 without using the multiply/divide operators, or loops
 //
@@ -4,91 +4,303 @@
 
 #include <vector>
 #include <cstdio>
-#include <iterator>
+#include <string>
 
 using std::vector;
-using std::copy;
-using std::back_inserter;
+using std::string;
 
-template <typename T> void PrintStack (T & stack) {
-    for (auto iter = stack.begin(), last = stack.end(); iter != last; ++iter)
-        putchar((*iter)->c);
+/* Walks the tree in preorder (left subtree before right subtree) while  */
+/* keeping the path from the root to the current node in path, which     */
+/* never grows beyond the height of the tree. visit is called with the   */
+/* path every time a node is reached and can stop the walk by returning  */
+/* true, in which case path is left pointing at that node.               */
+template <typename Visitor>
+bool WalkPreorder (Node * pRoot, vector<Node *> & path, Visitor visit) {
+    path.clear();
+    if (pRoot)
+        path.push_back(pRoot);
+
+    while (!path.empty()) {
+        Node * const top = path.back();
+
+        if (visit(path))
+            return true;
+
+        /* Climb down into the left leaf if there is one, otherwise the  */
+        /* right leaf.                                                   */
+        if (top->pLeft) {
+            path.push_back(top->pLeft);
+            continue;
+        } else if (top->pRight) {
+            path.push_back(top->pRight);
+            continue;
+        }
+
+        /* Once we run out of leaves, climb back up until we find a node */
+        /* whose left leaf we just came out of and which has a right     */
+        /* leaf we haven't visited yet, and pivot into that right leaf.  */
+        Node * popped = top;
+        path.pop_back();
+
+        while (!path.empty()) {
+            Node * const parent = path.back();
+
+            if ((parent->pLeft == popped) && parent->pRight) {
+                path.push_back(parent->pRight);
+                break;
+            }
+
+            popped = parent;
+            path.pop_back();
+        }
+    }
+
+    return false;
+}
+
+/* Returns the characters along the path to the deepest node in the      */
+/* tree. If several nodes are equally deep, the leftmost one wins.       */
+/* Rather than copying the whole traversal stack every time we reach a   */
+/* new depth, which is quadratic on a tree that degenerates into a list, */
+/* the first walk only remembers the deepest node. A second walk stops   */
+/* when it reaches that node, at which point its stack is the path we    */
+/* want. That is O(n) time and O(height) memory.                         */
+string StringToDeepestLeafNode (Node * pRoot) {
+    vector<Node *> path;
+    Node * deepest = 0;
+    size_t deepestDepth = 0;
+
+    WalkPreorder(pRoot, path, [&deepest, &deepestDepth] (const vector<Node *> & current) -> bool {
+        if (current.size() > deepestDepth) {
+            deepestDepth = current.size();
+            deepest = current.back();
+        }
+
+        return false;
+    });
+
+    WalkPreorder(pRoot, path, [deepest] (const vector<Node *> & current) -> bool {
+        return current.back() == deepest;
+    });
+
+    string result;
+    result.reserve(path.size());
+    for (auto iter = path.begin(), last = path.end(); iter != last; ++iter)
+        result.push_back((*iter)->c);
+
+    return result;
 }
 
 void PrintStringToDeepestLeafNode (Node * pRoot) {
-    Node * popped = 0;
-    vector<Node *> current, deepest;
-
-    current.push_back(pRoot);
-
-    while (size_t s = current.size()) {
-        /* Any time we reach a new depth we make a copy of the current       */
-        /* traversal stack so that the end of the function we will have all  */
-        /* the pointers we need to print the entire path.                    */
-        if (s > deepest.size()) {
-            deepest.clear();
-            copy(current.begin(), current.end(), back_inserter(deepest));
+    printf("Result: %s\n", StringToDeepestLeafNode(pRoot).c_str());
+}
+
+//
+// Find the deepest path in a large tree using every core.
+//
+
+#include <ppl.h>
+
+/* Fork-join version of StringToDeepestLeafNode. Every node with two     */
+/* children splits its subtrees into two tasks on the concurrency        */
+/* runtime's work-stealing scheduler, until forkDepth levels of forks    */
+/* have been made, after which each task searches its subtree serially.  */
+/* Nodes don't know the size of their subtrees, so the number of forks   */
+/* (at most 2^forkDepth tasks) stands in for a size threshold; runs of   */
+/* single children are followed without forking or using up forkDepth.   */
+/* Each task returns the path from its subtree root to the deepest node  */
+/* in it, and when merging two results the left one wins unless the      */
+/* right one is strictly deeper. That is the same leftmost tie-breaking  */
+/* as the serial walk, so both return the same path.                     */
+string ParallelStringToDeepestLeafNode (Node * pRoot, unsigned forkDepth = 10) {
+    if (!pRoot)
+        return string();
+    else if (forkDepth == 0)
+        return StringToDeepestLeafNode(pRoot);
+
+    string result;
+    Node * node = pRoot;
+
+    while (!(node->pLeft && node->pRight)) {
+        result.push_back(node->c);
+
+        node = node->pLeft ? node->pLeft : node->pRight;
+        if (!node)
+            return result;
+    }
+
+    string left, right;
+
+    Concurrency::parallel_invoke(
+        [&left, node, forkDepth] {
+            left = ParallelStringToDeepestLeafNode(node->pLeft, forkDepth - 1);
+        },
+        [&right, node, forkDepth] {
+            right = ParallelStringToDeepestLeafNode(node->pRight, forkDepth - 1);
         }
+    );
 
-        Node * const top = current[s - 1];
-        Node * const prior = s > 1 ? current[s - 2] : 0;
-
-        Node * const left = top->pLeft;
-        Node * const right = top->pRight;
-
-        bool const poppedLeft = (left == popped);
-        bool const poppedRight = (right == popped);
-
-        /* If the current node has a right leaf and we just climbed up from  */
-        /* the left leaf, then climb down into the right leaf                */
-        if (
-            right && poppedLeft
-        ) {
-            current.push_back(right);
-
-        /* Otherwise, if the current node has a left leaf and we have not    */
-        /* just climbed up from the right leaf of this node, climb down into */
-        /* the left leaf. We must also handle cases where there is no left   */
-        /* leaf and cases where there is no right leaf.                      */
-        } else if (
-            left && (
-                !poppedLeft && (!poppedRight || !right)
-            )
-        ) {
-            current.push_back(left);
+    result.push_back(node->c);
+    result += (right.size() > left.size()) ? right : left;
+    return result;
+}
 
-        /* If we decided not to climb down into either leaf it's time to     */
-        /* climb back up. First, we check whether we are currently inside    */
-        /* the left leaf of a node. If so, we may want to pivot into the     */
-        /* right leaf. If we can't pivot into the right leaf, we just climb  */
-        /* up.                                                               */
-        } else if (prior) {
-            Node * const priorRight = prior->pRight;
+//
+// Find the deepest path in a tree that has been flattened into an array.
+//
 
-            if (
-                (prior->pLeft == top) && 
-                priorRight && (priorRight != popped)
-            ) {
-                current[s - 1] = priorRight;
-
-            } else {
-                current.pop_back();
-                popped = top;
-                continue;
-            }
+#include <algorithm>
+#include <random>
+#include <ctime>
+
+/* Nodes are stored in preorder, so a node's left child (if any) always  */
+/* immediately follows it and only the index of the right child needs to */
+/* be stored. The root is at index 0 and can't be anyone's child, so 0   */
+/* means there is no right child.                                        */
+struct FlatNode {
+    char c;
+    bool hasLeft;
+    unsigned right;
+};
+
+/* Copies a tree into preorder. Right children are remembered on a stack */
+/* (at most the height of the tree) along with their parent's index, so  */
+/* the parent can be pointed at them once we get to them.                */
+vector<FlatNode> FlattenTree (Node * pRoot) {
+    vector<FlatNode> result;
+    vector<std::pair<Node *, unsigned> > pendingRight;
+    Node * node = pRoot;
+
+    while (node || !pendingRight.empty()) {
+        if (!node) {
+            node = pendingRight.back().first;
+            result[pendingRight.back().second].right = (unsigned)result.size();
+            pendingRight.pop_back();
+        }
+
+        const FlatNode flat = { node->c, node->pLeft != 0, 0 };
+        if (node->pRight)
+            pendingRight.push_back(std::make_pair(node->pRight, (unsigned)result.size()));
+
+        result.push_back(flat);
+        node = node->pLeft;
+    }
+
+    return result;
+}
+
+/* The flattened version of StringToDeepestLeafNode. Because children    */
+/* always come after their parents, a single forward pass can compute    */
+/* every node's depth from its parent's, and the first node found at the */
+/* greatest depth is the leftmost one. Every node between a parent and   */
+/* its child belongs to the parent's left subtree and is deeper than the */
+/* parent, so walking backwards from the deepest node, the first node    */
+/* one level up is always its parent. Both passes read the array in      */
+/* order, which the hardware prefetcher handles far better than chasing  */
+/* pointers to nodes scattered around the heap.                          */
+string StringToDeepestLeafNode (const vector<FlatNode> & tree) {
+    if (tree.empty())
+        return string();
+
+    vector<unsigned> depth(tree.size());
+    size_t deepest = 0;
+
+    for (size_t i = 0; i < tree.size(); i++) {
+        const unsigned d = depth[i];
+        if (d > depth[deepest])
+            deepest = i;
+
+        if (tree[i].hasLeft)
+            depth[i + 1] = d + 1;
+        if (tree[i].right)
+            depth[tree[i].right] = d + 1;
+    }
+
+    unsigned wanted = depth[deepest];
+    string result(wanted + 1, '\0');
 
-        } else {
-            break;
+    for (size_t i = deepest + 1; i-- > 0; ) {
+        if (depth[i] == wanted) {
+            result[wanted] = tree[i].c;
+            if (wanted-- == 0)
+                break;
         }
+    }
+
+    return result;
+}
+
+/* Builds a tree of count nodes whose nodes are scattered around the     */
+/* heap, the way they end up after a long-running program has allocated  */
+/* and freed lots of memory. Each node is attached to a random free      */
+/* child slot; with skewed set, most nodes are instead attached as the   */
+/* left child of the previous node, making the tree much deeper.         */
+static Node * MakeScatteredTree (size_t count, bool skewed, vector<Node *> & allocated, std::mt19937 & random) {
+    std::uniform_int_distribution<int> letter(0, 25), oneInTen(0, 9);
+
+    allocated.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        allocated[i] = new Node();
+        allocated[i]->c = 'a' + (char)letter(random);
+        allocated[i]->pLeft = allocated[i]->pRight = 0;
+    }
+
+    std::shuffle(allocated.begin(), allocated.end(), random);
+
+    vector<Node **> freeSlots;
+    for (size_t i = 1; i < count; i++) {
+        Node * const parent = allocated[i - 1];
+        freeSlots.push_back(&parent->pLeft);
+        freeSlots.push_back(&parent->pRight);
+
+        size_t slot = freeSlots.size() - 2;
+        if (!skewed || (oneInTen(random) == 0))
+            slot = std::uniform_int_distribution<size_t>(0, freeSlots.size() - 1)(random);
 
-        popped = 0;
+        *freeSlots[slot] = allocated[i];
+        freeSlots[slot] = freeSlots.back();
+        freeSlots.pop_back();
     }
 
-    printf("Result: ");
-    PrintStack(deepest);
-    printf("\n");
+    return count ? allocated[0] : 0;
 }
 
+/* Times the pointer-based and flattened deepest path searches on large  */
+/* random and skewed trees and checks that they find the same path.      */
+void BenchmarkFlattenedTree (size_t count, unsigned iterations) {
+    std::mt19937 random(1234);
+
+    for (int skewed = 0; skewed < 2; skewed++) {
+        vector<Node *> allocated;
+        Node * const root = MakeScatteredTree(count, skewed != 0, allocated, random);
+
+        clock_t start = clock();
+        string pointerResult;
+        for (unsigned i = 0; i < iterations; i++)
+            pointerResult = StringToDeepestLeafNode(root);
+        const double pointerSeconds = double(clock() - start) / CLOCKS_PER_SEC;
+
+        start = clock();
+        const vector<FlatNode> flat = FlattenTree(root);
+        const double flattenSeconds = double(clock() - start) / CLOCKS_PER_SEC;
+
+        start = clock();
+        string flatResult;
+        for (unsigned i = 0; i < iterations; i++)
+            flatResult = StringToDeepestLeafNode(flat);
+        const double flatSeconds = double(clock() - start) / CLOCKS_PER_SEC;
+
+        printf("%s tree, depth %u:\n", skewed ? "Skewed" : "Random", (unsigned)pointerResult.size());
+        printf("  pointers:  %.3f s per search\n", pointerSeconds / iterations);
+        printf("  flattened: %.3f s per search (%.3f s to flatten)\n", flatSeconds / iterations, flattenSeconds);
+        printf("  results %s\n", (pointerResult == flatResult) ? "match" : "DO NOT MATCH");
+
+        for (auto iter = allocated.begin(), last = allocated.end(); iter != last; ++iter)
+            delete *iter;
+    }
+}
+
+
 //
 // Determine which, if any, of a pair of bounding boxes encloses the other.
 //
@@ -186,4 +398,513 @@ Enclosing CheckEnclosing (const AABB & first, const AABB & second) {
                     return SECOND;
             }
     }
-}
\ No newline at end of file
+}
+
+//
+// Compare one bounding box against many bounding boxes at once.
+//
+
+#include <emmintrin.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+#include <cstdlib>
+#include <ctime>
+
+/* The batch functions write each result as an int-sized lane, so the    */
+/* enum must be exactly that size.                                       */
+static_assert(sizeof(Enclosing) == sizeof(int), "Enclosing must be the size of an int");
+
+/* Boxes to be tested in bulk are stored as a structure of arrays so     */
+/* that each coordinate can be loaded for several boxes at once.         */
+struct AABBArrays {
+    const int * x1, * x2;
+    const int * y1, * y2;
+    size_t count;
+};
+
+/* Instead of computing an Enclosing per axis and then combining them,   */
+/* note that first encloses (or is the same as) second exactly when      */
+/* first's interval contains second's interval on both axes, and vice    */
+/* versa. With F and S as all-ones masks for those two conditions, the   */
+/* result is (F - S) + ((F & S) & SAME): -1 for FIRST, 1 for SECOND, 2   */
+/* for SAME and 0 for NEITHER, which is exactly how Enclosing is laid    */
+/* out. SSE2 only has a greater-than comparison, so we compute the masks */
+/* for the opposite conditions (some coordinate sticks out) and invert   */
+/* them.                                                                 */
+static inline __m128i CheckEnclosingLanes (
+    const __m128i firstX1, const __m128i firstX2,
+    const __m128i firstY1, const __m128i firstY2,
+    const __m128i x1, const __m128i x2, const __m128i y1, const __m128i y2
+) {
+    const __m128i secondSticksOut = _mm_or_si128(
+        _mm_or_si128(_mm_cmpgt_epi32(firstX1, x1), _mm_cmpgt_epi32(x2, firstX2)),
+        _mm_or_si128(_mm_cmpgt_epi32(firstY1, y1), _mm_cmpgt_epi32(y2, firstY2))
+    );
+    const __m128i firstSticksOut = _mm_or_si128(
+        _mm_or_si128(_mm_cmpgt_epi32(x1, firstX1), _mm_cmpgt_epi32(firstX2, x2)),
+        _mm_or_si128(_mm_cmpgt_epi32(y1, firstY1), _mm_cmpgt_epi32(firstY2, y2))
+    );
+
+    const __m128i allOnes = _mm_set1_epi32(-1);
+    const __m128i f = _mm_xor_si128(secondSticksOut, allOnes);
+    const __m128i s = _mm_xor_si128(firstSticksOut, allOnes);
+
+    return _mm_add_epi32(
+        _mm_sub_epi32(f, s),
+        _mm_and_si128(_mm_and_si128(f, s), _mm_set1_epi32(SAME))
+    );
+}
+
+#ifdef __AVX2__
+/* The same computation as CheckEnclosingLanes, eight boxes at a time.   */
+static inline __m256i CheckEnclosingLanes (
+    const __m256i firstX1, const __m256i firstX2,
+    const __m256i firstY1, const __m256i firstY2,
+    const __m256i x1, const __m256i x2, const __m256i y1, const __m256i y2
+) {
+    const __m256i secondSticksOut = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpgt_epi32(firstX1, x1), _mm256_cmpgt_epi32(x2, firstX2)),
+        _mm256_or_si256(_mm256_cmpgt_epi32(firstY1, y1), _mm256_cmpgt_epi32(y2, firstY2))
+    );
+    const __m256i firstSticksOut = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpgt_epi32(x1, firstX1), _mm256_cmpgt_epi32(firstX2, x2)),
+        _mm256_or_si256(_mm256_cmpgt_epi32(y1, firstY1), _mm256_cmpgt_epi32(firstY2, y2))
+    );
+
+    const __m256i allOnes = _mm256_set1_epi32(-1);
+    const __m256i f = _mm256_xor_si256(secondSticksOut, allOnes);
+    const __m256i s = _mm256_xor_si256(firstSticksOut, allOnes);
+
+    return _mm256_add_epi32(
+        _mm256_sub_epi32(f, s),
+        _mm256_and_si256(_mm256_and_si256(f, s), _mm256_set1_epi32(SAME))
+    );
+}
+#endif
+
+/* Compares first against every box in others, storing the Enclosing     */
+/* result for others[i] in results[i]. Eight boxes are compared per step */
+/* when compiling for AVX2 (/arch:AVX2 or -mavx2 defines __AVX2__) and   */
+/* four otherwise; any boxes left over are compared one at a time using  */
+/* CheckEnclosing.                                                       */
+void CheckEnclosingBatch (
+    const AABB & first, const AABBArrays & others, Enclosing * results
+) {
+    size_t i = 0;
+
+    const __m128i firstX1 = _mm_set1_epi32(first.x1);
+    const __m128i firstX2 = _mm_set1_epi32(first.x2);
+    const __m128i firstY1 = _mm_set1_epi32(first.y1);
+    const __m128i firstY2 = _mm_set1_epi32(first.y2);
+
+#ifdef __AVX2__
+    const __m256i firstX1x8 = _mm256_set1_epi32(first.x1);
+    const __m256i firstX2x8 = _mm256_set1_epi32(first.x2);
+    const __m256i firstY1x8 = _mm256_set1_epi32(first.y1);
+    const __m256i firstY2x8 = _mm256_set1_epi32(first.y2);
+
+    for (; i + 8 <= others.count; i += 8) {
+        const __m256i result = CheckEnclosingLanes(
+            firstX1x8, firstX2x8, firstY1x8, firstY2x8,
+            _mm256_loadu_si256((const __m256i *)(others.x1 + i)),
+            _mm256_loadu_si256((const __m256i *)(others.x2 + i)),
+            _mm256_loadu_si256((const __m256i *)(others.y1 + i)),
+            _mm256_loadu_si256((const __m256i *)(others.y2 + i))
+        );
+        _mm256_storeu_si256((__m256i *)(results + i), result);
+    }
+#endif
+
+    for (; i + 4 <= others.count; i += 4) {
+        const __m128i result = CheckEnclosingLanes(
+            firstX1, firstX2, firstY1, firstY2,
+            _mm_loadu_si128((const __m128i *)(others.x1 + i)),
+            _mm_loadu_si128((const __m128i *)(others.x2 + i)),
+            _mm_loadu_si128((const __m128i *)(others.y1 + i)),
+            _mm_loadu_si128((const __m128i *)(others.y2 + i))
+        );
+        _mm_storeu_si128((__m128i *)(results + i), result);
+    }
+
+    for (; i < others.count; i++) {
+        const AABB second = {
+            others.x1[i], others.x2[i], others.y1[i], others.y2[i]
+        };
+        results[i] = CheckEnclosing(first, second);
+    }
+}
+
+/* Times CheckEnclosingBatch against calling CheckEnclosing once per     */
+/* pair on the same randomly generated boxes, and verifies that both     */
+/* produce the same results. Coordinates are drawn from a small range so */
+/* that every kind of result shows up.                                   */
+void BenchmarkCheckEnclosingBatch (size_t count, unsigned iterations) {
+    vector<AABB> boxes(count);
+    vector<int> x1(count), x2(count), y1(count), y2(count);
+    vector<Enclosing> scalarResults(count), batchResults(count);
+
+    srand(1234);
+    for (size_t i = 0; i < count; i++) {
+        AABB & box = boxes[i];
+        box.x1 = rand() % 16;
+        box.x2 = box.x1 + rand() % 16;
+        box.y1 = rand() % 16;
+        box.y2 = box.y1 + rand() % 16;
+
+        x1[i] = box.x1;
+        x2[i] = box.x2;
+        y1[i] = box.y1;
+        y2[i] = box.y2;
+    }
+
+    const AABB query = { 4, 12, 4, 12 };
+    const AABBArrays others = { &x1[0], &x2[0], &y1[0], &y2[0], count };
+
+    clock_t start = clock();
+    for (unsigned j = 0; j < iterations; j++)
+        for (size_t i = 0; i < count; i++)
+            scalarResults[i] = CheckEnclosing(query, boxes[i]);
+    const double scalarSeconds = double(clock() - start) / CLOCKS_PER_SEC;
+
+    start = clock();
+    for (unsigned j = 0; j < iterations; j++)
+        CheckEnclosingBatch(query, others, &batchResults[0]);
+    const double batchSeconds = double(clock() - start) / CLOCKS_PER_SEC;
+
+    size_t mismatches = 0;
+    for (size_t i = 0; i < count; i++)
+        mismatches += (scalarResults[i] != batchResults[i]);
+
+    const double pairs = double(count) * iterations;
+    printf("CheckEnclosing:      %.1f million pairs/s\n", pairs / scalarSeconds / 1e6);
+    printf("CheckEnclosingBatch: %.1f million pairs/s\n", pairs / batchSeconds / 1e6);
+    printf("Mismatched results:  %u\n", (unsigned)mismatches);
+}
+
+
+//
+// Find every bounding box in a set that encloses, or is enclosed by, a query box.
+//
+
+#include <algorithm>
+#include <climits>
+
+/* One box enclosing another is the same as the box's corner coordinates */
+/* falling within inclusive ranges: B encloses Q exactly when B.x1 <=    */
+/* Q.x1, B.x2 >= Q.x2, B.y1 <= Q.y1 and B.y2 >= Q.y2. If we treat each   */
+/* box as a point (x1, x2, y1, y2) in four dimensions, both kinds of     */
+/* query become orthogonal range queries over those points, which a k-d  */
+/* tree answers without looking at most of the boxes.                    */
+
+/* Box first encloses box second (result FIRST), or they are identical   */
+/* (result SAME).                                                        */
+struct EnclosingPair {
+    size_t first, second;
+    Enclosing result;
+};
+
+class AABBIndex {
+public:
+    /* The index refers to boxes by their position in this vector, which */
+    /* it keeps a copy of.                                               */
+    explicit AABBIndex (const vector<AABB> & boxes);
+
+    /* Appends the indices of all boxes that enclose or are the same as  */
+    /* query.                                                            */
+    void FindEnclosing (const AABB & query, vector<size_t> & result) const;
+    /* Appends the indices of all boxes that query encloses or is the    */
+    /* same as.                                                          */
+    void FindEnclosedBy (const AABB & query, vector<size_t> & result) const;
+    /* Appends every pair of boxes in the set where one encloses the     */
+    /* other. Identical boxes are reported once, as SAME.                */
+    void FindAllEnclosingPairs (vector<EnclosingPair> & result) const;
+
+private:
+    /* Leaves hold up to this many boxes, which are tested one at a      */
+    /* time.                                                             */
+    static const size_t LEAF_SIZE = 8;
+
+    struct Range {
+        int low[4], high[4];
+    };
+
+    /* Nodes are stored in preorder, so a node's left child immediately  */
+    /* follows it. Each node covers order[begin, end) and stores the     */
+    /* bounds of the points it covers in every dimension.                */
+    struct IndexNode {
+        Range bounds;
+        size_t begin, end;
+        size_t right;
+    };
+
+    vector<AABB> boxes;
+    vector<size_t> order;
+    vector<IndexNode> nodes;
+
+    static inline int Coordinate (const AABB & box, unsigned dimension) {
+        switch (dimension) {
+            case 0: return box.x1;
+            case 1: return box.x2;
+            case 2: return box.y1;
+            default: return box.y2;
+        }
+    }
+
+    size_t Build (size_t begin, size_t end);
+    void Query (size_t nodeIndex, const Range & range, vector<size_t> & result) const;
+};
+
+AABBIndex::AABBIndex (const vector<AABB> & _boxes)
+    : boxes(_boxes)
+{
+    order.resize(boxes.size());
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = i;
+
+    if (!boxes.empty()) {
+        nodes.reserve((2 * boxes.size()) / LEAF_SIZE + 1);
+        Build(0, boxes.size());
+    }
+}
+
+/* Builds the subtree covering order[begin, end) and returns the index   */
+/* of its root. Each split is made at the median along the dimension in  */
+/* which the points are most spread out.                                 */
+size_t AABBIndex::Build (size_t begin, size_t end) {
+    const size_t nodeIndex = nodes.size();
+    nodes.push_back(IndexNode());
+
+    Range bounds;
+    for (unsigned d = 0; d < 4; d++) {
+        bounds.low[d] = INT_MAX;
+        bounds.high[d] = INT_MIN;
+    }
+
+    for (size_t i = begin; i < end; i++) {
+        for (unsigned d = 0; d < 4; d++) {
+            const int c = Coordinate(boxes[order[i]], d);
+            bounds.low[d] = std::min(bounds.low[d], c);
+            bounds.high[d] = std::max(bounds.high[d], c);
+        }
+    }
+
+    size_t right = 0;
+
+    if (end - begin > LEAF_SIZE) {
+        unsigned splitDimension = 0;
+        for (unsigned d = 1; d < 4; d++) {
+            if (
+                (double)bounds.high[d] - bounds.low[d] >
+                (double)bounds.high[splitDimension] - bounds.low[splitDimension]
+            )
+                splitDimension = d;
+        }
+
+        const size_t middle = begin + (end - begin) / 2;
+        const vector<AABB> & b = boxes;
+        std::nth_element(
+            order.begin() + begin, order.begin() + middle, order.begin() + end,
+            [&b, splitDimension] (size_t lhs, size_t rhs) {
+                return Coordinate(b[lhs], splitDimension) < Coordinate(b[rhs], splitDimension);
+            }
+        );
+
+        Build(begin, middle);
+        right = Build(middle, end);
+    }
+
+    /* Children may have reallocated the node vector, so only now do we  */
+    /* fill in this node.                                                */
+    IndexNode & node = nodes[nodeIndex];
+    node.bounds = bounds;
+    node.begin = begin;
+    node.end = end;
+    node.right = right;
+
+    return nodeIndex;
+}
+
+void AABBIndex::Query (size_t nodeIndex, const Range & range, vector<size_t> & result) const {
+    const IndexNode & node = nodes[nodeIndex];
+    bool containsNode = true;
+
+    for (unsigned d = 0; d < 4; d++) {
+        /* None of this node's points can be in range.                   */
+        if ((node.bounds.high[d] < range.low[d]) || (node.bounds.low[d] > range.high[d]))
+            return;
+
+        if ((node.bounds.low[d] < range.low[d]) || (node.bounds.high[d] > range.high[d]))
+            containsNode = false;
+    }
+
+    /* All of this node's points are in range, so there is nothing left  */
+    /* to test.                                                          */
+    if (containsNode) {
+        result.insert(result.end(), order.begin() + node.begin, order.begin() + node.end);
+        return;
+    }
+
+    if (node.right == 0) {
+        for (size_t i = node.begin; i < node.end; i++) {
+            const AABB & box = boxes[order[i]];
+            bool inRange = true;
+
+            for (unsigned d = 0; d < 4; d++) {
+                const int c = Coordinate(box, d);
+                inRange &= (c >= range.low[d]) && (c <= range.high[d]);
+            }
+
+            if (inRange)
+                result.push_back(order[i]);
+        }
+
+        return;
+    }
+
+    Query(nodeIndex + 1, range, result);
+    Query(node.right, range, result);
+}
+
+void AABBIndex::FindEnclosing (const AABB & query, vector<size_t> & result) const {
+    if (nodes.empty())
+        return;
+
+    const Range range = {
+        { INT_MIN, query.x2, INT_MIN, query.y2 },
+        { query.x1, INT_MAX, query.y1, INT_MAX }
+    };
+    Query(0, range, result);
+}
+
+void AABBIndex::FindEnclosedBy (const AABB & query, vector<size_t> & result) const {
+    if (nodes.empty())
+        return;
+
+    const Range range = {
+        { query.x1, INT_MIN, query.y1, INT_MIN },
+        { INT_MAX, query.x2, INT_MAX, query.y2 }
+    };
+    Query(0, range, result);
+}
+
+/* Runs one FindEnclosedBy query per box. Each query only visits the     */
+/* parts of the tree that can contain results, so unless most boxes      */
+/* enclose each other this is much faster than comparing every pair.     */
+void AABBIndex::FindAllEnclosingPairs (vector<EnclosingPair> & result) const {
+    vector<size_t> enclosed;
+
+    for (size_t i = 0; i < boxes.size(); i++) {
+        const AABB & first = boxes[i];
+        enclosed.clear();
+        FindEnclosedBy(first, enclosed);
+
+        for (auto iter = enclosed.begin(), last = enclosed.end(); iter != last; ++iter) {
+            const size_t j = *iter;
+            const AABB & second = boxes[j];
+            const bool same =
+                (first.x1 == second.x1) && (first.x2 == second.x2) &&
+                (first.y1 == second.y1) && (first.y2 == second.y2);
+
+            /* Identical boxes find each other, so we keep only one of   */
+            /* the two results.                                          */
+            if (same && (j <= i))
+                continue;
+
+            const EnclosingPair pair = { i, j, same ? SAME : FIRST };
+            result.push_back(pair);
+        }
+    }
+}
+
+/* Times FindAllEnclosingPairs against calling CheckEnclosing on every   */
+/* pair of the same randomly generated boxes, and verifies that both     */
+/* find the same number of pairs.                                        */
+void BenchmarkAABBIndex (size_t count) {
+    vector<AABB> boxes(count);
+
+    srand(1234);
+    for (size_t i = 0; i < count; i++) {
+        AABB & box = boxes[i];
+        box.x1 = rand() % 10000;
+        box.x2 = box.x1 + rand() % 500;
+        box.y1 = rand() % 10000;
+        box.y2 = box.y1 + rand() % 500;
+    }
+
+    clock_t start = clock();
+    size_t bruteForcePairs = 0;
+    for (size_t i = 0; i < count; i++) {
+        for (size_t j = i + 1; j < count; j++)
+            bruteForcePairs += (CheckEnclosing(boxes[i], boxes[j]) != NEITHER);
+    }
+    const double bruteForceSeconds = double(clock() - start) / CLOCKS_PER_SEC;
+
+    start = clock();
+    const AABBIndex index(boxes);
+    vector<EnclosingPair> pairs;
+    index.FindAllEnclosingPairs(pairs);
+    const double indexSeconds = double(clock() - start) / CLOCKS_PER_SEC;
+
+    printf("CheckEnclosing on all pairs: %.3f s, %u pairs\n", bruteForceSeconds, (unsigned)bruteForcePairs);
+    printf("AABBIndex (including build): %.3f s, %u pairs\n", indexSeconds, (unsigned)pairs.size());
+    printf("Pair counts:                 %s\n", (bruteForcePairs == pairs.size()) ? "match" : "MISMATCH");
+}
+
+
+//
+// Determine which, if any, of a pair of bounding boxes encloses the other, for boxes of any
+//  dimension and coordinate type, without branching.
+//
+
+/* The number of dimensions is a template parameter, so the loops over   */
+/* the axes below have a constant trip count and are unrolled by the     */
+/* compiler; a 3D box costs exactly three axis comparisons.              */
+template <unsigned Dimensions, typename Coordinate>
+struct BoundingBox {
+    Coordinate min[Dimensions];
+    Coordinate max[Dimensions];
+};
+
+typedef BoundingBox<2, int>    AABB2i;
+typedef BoundingBox<2, float>  AABB2f;
+typedef BoundingBox<3, int>    AABB3i;
+typedef BoundingBox<3, float>  AABB3f;
+typedef BoundingBox<3, double> AABB3d;
+
+/* CheckEnclosing switches on the result for each axis, and which case   */
+/* is taken is essentially random for unrelated boxes. Instead we keep   */
+/* one bit that says whether first contains second on every axis so far  */
+/* and one bit for the reverse, combining axes with &. The Enclosing     */
+/* value then falls out of arithmetic on the two bits: (s - f) is -1 for */
+/* FIRST, 1 for SECOND and 0 for NEITHER or SAME, and adding 2 * (f & s) */
+/* turns the last case into SAME. Comparisons compile to setcc (or       */
+/* cmpss/cmpsd for floating point), so there is nothing to mispredict.   */
+/* Any comparison involving NaN is false, so NaN boxes enclose nothing.  */
+template <unsigned Dimensions, typename Coordinate>
+inline Enclosing CheckEnclosing (
+    const BoundingBox<Dimensions, Coordinate> & first,
+    const BoundingBox<Dimensions, Coordinate> & second
+) {
+    int firstContains = 1, secondContains = 1;
+
+    for (unsigned d = 0; d < Dimensions; d++) {
+        firstContains &=
+            int(first.min[d] <= second.min[d]) & int(second.max[d] <= first.max[d]);
+        secondContains &=
+            int(second.min[d] <= first.min[d]) & int(first.max[d] <= second.max[d]);
+    }
+
+    return Enclosing(
+        (secondContains - firstContains) + 2 * (firstContains & secondContains)
+    );
+}
+
+/* Lets existing AABBs use the branch-free version.                      */
+inline AABB2i ToBoundingBox (const AABB & box) {
+    const AABB2i result = {
+        { box.x1, box.y1 },
+        { box.x2, box.y2 }
+    };
+    return result;
+}